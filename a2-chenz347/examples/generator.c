@@ -0,0 +1,96 @@
+/**
+ * @file An application that consumes a generator written as a coroutine, and
+ * compares the cost of a resume/yield round trip with a thread yield.
+ */
+#include <assert.h>
+#include <stdlib.h>
+#include <sys/time.h>
+
+#include "csc369_interrupts.h"
+#include "csc369_thread.h"
+
+// Number of values the generator produces
+#define GENERATOR_COUNT 200000
+
+// Set once the ping-pong partner should stop yielding
+int done = 0;
+
+void
+f_count_up(long limit)
+{
+  for (long i = 1; i <= limit; i++) {
+    CSC369_CoYield((void*)i);
+  }
+}
+
+void
+f_yield_back(void)
+{
+  while (!__sync_fetch_and_add(&done, 0)) {
+    CSC369_ThreadYield();
+  }
+}
+
+double
+elapsed_us(struct timeval* start)
+{
+  struct timeval end, diff;
+  gettimeofday(&end, NULL);
+  timersub(&end, start, &diff);
+  return diff.tv_sec * 1000000.0 + diff.tv_usec;
+}
+
+void
+run_generator(void)
+{
+  struct timeval start;
+
+  // Sum the generated values, one resume/yield round trip per value
+  CSC369_Coroutine* co =
+    CSC369_CoCreate((void (*)(void*))f_count_up, (void*)GENERATOR_COUNT);
+  assert(co != NULL);
+
+  long sum = 0;
+  void* value;
+  gettimeofday(&start, NULL);
+  while (CSC369_CoResume(co, &value) == 1) {
+    sum += (long)value;
+  }
+  double const co_us = elapsed_us(&start);
+  CSC369_CoDestroy(co);
+  assert(sum == (long)GENERATOR_COUNT * (GENERATOR_COUNT + 1) / 2);
+
+  // The same number of round trips between two threads
+  Tid tid = CSC369_ThreadCreate((void (*)(void*))f_yield_back, NULL);
+  assert(tid > 0);
+  gettimeofday(&start, NULL);
+  for (int i = 0; i < GENERATOR_COUNT; i++) {
+    CSC369_ThreadYield();
+  }
+  double const thread_us = elapsed_us(&start);
+  __sync_fetch_and_add(&done, 1);
+
+  int exit_code;
+  CSC369_ThreadJoin(tid, &exit_code);
+
+  CSC369_InterruptsPrintf("generator sum %ld\n", sum);
+  CSC369_InterruptsPrintf("resume/yield round trip: %.3f us\n",
+                          co_us / GENERATOR_COUNT);
+  CSC369_InterruptsPrintf("thread yield round trip: %.3f us\n",
+                          thread_us / GENERATOR_COUNT);
+}
+
+int
+main(void)
+{
+  // Initialize the user-level thread package
+  CSC369_ThreadInit();
+  // Initialize and enable interrupts
+  CSC369_InterruptsInit();
+  // Uninterrupted prints are expensive, keep the interrupts logging quiet
+  CSC369_InterruptsSetLogLevel(CSC369_INTERRUPTS_QUIET);
+
+  run_generator();
+
+  return 0;
+}
@@ -19,9 +19,10 @@ f_spin_and_join(int num)
   // Generate a random amount of time to spin for
   double const rand = ((double)random()) / RAND_MAX * 1000000;
 
-  // Wait until the main thread has created all other threads before continuing
+  // Wait until the main thread has created all other threads before continuing.
+  // Polling lets a deterministic schedule preempt this loop.
   while (__sync_fetch_and_add(&ALL_THREADS_CREATED, 0) < 1)
-    ;
+    CSC369_InterruptsPoll();
 
   // Spin, using up the CPU
   CSC369_ThreadSpin((int)rand);
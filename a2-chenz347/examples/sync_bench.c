@@ -0,0 +1,262 @@
+/**
+ * @file An application that measures the throughput of the reader-writer lock
+ * and the barrier, next to a lock and a barrier built by hand from
+ * CSC369_ThreadSleep and CSC369_ThreadWakeNext, which wake every waiter one
+ * at a time whenever any of them may proceed.
+ */
+#include <assert.h>
+#include <stdlib.h>
+#include <sys/time.h>
+
+#include "csc369_interrupts.h"
+#include "csc369_thread.h"
+
+// Number of reader and writer threads sharing the table
+#define READER_COUNT 12
+#define WRITER_COUNT 2
+// Number of entries in the shared table
+#define TABLE_SIZE 256
+// Approximately how long the reader-writer lock benchmark runs
+#define RWLOCK_DURATION 2000000
+// Number of threads and rounds in the barrier benchmarks
+#define BARRIER_THREADS 32
+#define BARRIER_ROUNDS 2000
+
+long table[TABLE_SIZE];
+CSC369_RwLock* table_lock;
+long read_ops = 0;
+long write_ops = 0;
+int stop = 0;
+// Whether the table is guarded by the hand-built lock instead of table_lock
+int use_naive_lock = 0;
+// State of the hand-built reader-writer lock. Readers get in whenever no
+// writer holds it, so a steady stream of readers starves the writers.
+CSC369_WaitQueue* naive_lock_queue;
+int naive_readers = 0;
+int naive_writer = 0;
+
+CSC369_Barrier* barrier;
+// State of the hand-built barrier
+CSC369_WaitQueue* naive_queue;
+int naive_arrived = 0;
+int naive_round = 0;
+
+void
+naive_wake_all(CSC369_WaitQueue* queue)
+{
+  while (CSC369_ThreadWakeNext(queue) > 0) {
+  }
+}
+
+void
+naive_read_lock(void)
+{
+  CSC369_InterruptsState const prev_state = CSC369_InterruptsDisable();
+  while (naive_writer) {
+    CSC369_ThreadSleep(naive_lock_queue);
+  }
+  naive_readers++;
+  CSC369_InterruptsSet(prev_state);
+}
+
+void
+naive_write_lock(void)
+{
+  CSC369_InterruptsState const prev_state = CSC369_InterruptsDisable();
+  while (naive_writer || naive_readers > 0) {
+    CSC369_ThreadSleep(naive_lock_queue);
+  }
+  naive_writer = 1;
+  CSC369_InterruptsSet(prev_state);
+}
+
+void
+naive_unlock(void)
+{
+  CSC369_InterruptsState const prev_state = CSC369_InterruptsDisable();
+  if (naive_writer) {
+    naive_writer = 0;
+  } else {
+    naive_readers--;
+  }
+  if (naive_readers == 0) {
+    naive_wake_all(naive_lock_queue);
+  }
+  CSC369_InterruptsSet(prev_state);
+}
+
+void
+f_reader(void)
+{
+  while (!__sync_fetch_and_add(&stop, 0)) {
+    if (use_naive_lock) {
+      naive_read_lock();
+    } else {
+      CSC369_RwLockRead(table_lock);
+    }
+    long sum = 0;
+    for (int i = 0; i < TABLE_SIZE; i++) {
+      sum += table[i];
+    }
+    assert(sum % TABLE_SIZE == 0);
+    if (use_naive_lock) {
+      naive_unlock();
+    } else {
+      CSC369_RwLockUnlock(table_lock);
+    }
+    __sync_fetch_and_add(&read_ops, 1);
+  }
+}
+
+void
+f_writer(void)
+{
+  while (!__sync_fetch_and_add(&stop, 0)) {
+    if (use_naive_lock) {
+      naive_write_lock();
+    } else {
+      CSC369_RwLockWrite(table_lock);
+    }
+    for (int i = 0; i < TABLE_SIZE; i++) {
+      table[i]++;
+    }
+    if (use_naive_lock) {
+      naive_unlock();
+    } else {
+      CSC369_RwLockUnlock(table_lock);
+    }
+    __sync_fetch_and_add(&write_ops, 1);
+    CSC369_ThreadSpin(CSC369_INTERRUPTS_SIGNAL_INTERVAL);
+  }
+}
+
+void
+f_barrier(void)
+{
+  for (int i = 0; i < BARRIER_ROUNDS; i++) {
+    CSC369_BarrierWait(barrier);
+  }
+}
+
+void
+naive_barrier_wait(void)
+{
+  CSC369_InterruptsState const prev_state = CSC369_InterruptsDisable();
+  int const round = naive_round;
+  if (++naive_arrived == BARRIER_THREADS) {
+    naive_arrived = 0;
+    naive_round++;
+    naive_wake_all(naive_queue);
+  } else {
+    while (naive_round == round) {
+      CSC369_ThreadSleep(naive_queue);
+    }
+  }
+  CSC369_InterruptsSet(prev_state);
+}
+
+void
+f_naive_barrier(void)
+{
+  for (int i = 0; i < BARRIER_ROUNDS; i++) {
+    naive_barrier_wait();
+  }
+}
+
+double
+elapsed_us(struct timeval* start)
+{
+  struct timeval end, diff;
+  gettimeofday(&end, NULL);
+  timersub(&end, start, &diff);
+  return diff.tv_sec * 1000000.0 + diff.tv_usec;
+}
+
+double
+run_barrier(void (*f)(void))
+{
+  Tid tids[BARRIER_THREADS];
+  struct timeval start;
+  gettimeofday(&start, NULL);
+  for (int i = 0; i < BARRIER_THREADS; i++) {
+    tids[i] = CSC369_ThreadCreate((void (*)(void*))f, NULL);
+    assert(tids[i] > 0);
+  }
+  int exit_code;
+  for (int i = 0; i < BARRIER_THREADS; i++) {
+    CSC369_ThreadJoin(tids[i], &exit_code);
+  }
+  return BARRIER_ROUNDS / (elapsed_us(&start) / 1000000);
+}
+
+void
+run_rwlock(char const* name)
+{
+  read_ops = 0;
+  write_ops = 0;
+  stop = 0;
+  Tid tids[READER_COUNT + WRITER_COUNT];
+  for (int i = 0; i < READER_COUNT + WRITER_COUNT; i++) {
+    tids[i] = CSC369_ThreadCreate(
+      (void (*)(void*))(i < READER_COUNT ? f_reader : f_writer), NULL);
+    assert(tids[i] > 0);
+  }
+  CSC369_ThreadSpin(RWLOCK_DURATION);
+  __sync_fetch_and_add(&stop, 1);
+
+  int exit_code;
+  for (int i = 0; i < READER_COUNT + WRITER_COUNT; i++) {
+    CSC369_ThreadJoin(tids[i], &exit_code);
+  }
+  CSC369_InterruptsPrintf("%s: %.0f reads/s, %.0f writes/s\n",
+                          name,
+                          read_ops / (RWLOCK_DURATION / 1000000.0),
+                          write_ops / (RWLOCK_DURATION / 1000000.0));
+}
+
+void
+run_sync_bench(void)
+{
+  table_lock = CSC369_RwLockCreate();
+  assert(table_lock != NULL);
+  run_rwlock("rwlock");
+  CSC369_RwLockDestroy(table_lock);
+
+  naive_lock_queue = CSC369_WaitQueueCreate();
+  assert(naive_lock_queue != NULL);
+  use_naive_lock = 1;
+  run_rwlock("sleep/wake-one rwlock");
+  CSC369_WaitQueueDestroy(naive_lock_queue);
+
+  barrier = CSC369_BarrierCreate(BARRIER_THREADS);
+  assert(barrier != NULL);
+  double const rounds = run_barrier(f_barrier);
+  CSC369_BarrierDestroy(barrier);
+
+  naive_queue = CSC369_WaitQueueCreate();
+  assert(naive_queue != NULL);
+  double const naive_rounds = run_barrier(f_naive_barrier);
+  CSC369_WaitQueueDestroy(naive_queue);
+
+  CSC369_InterruptsPrintf("barrier (%d threads): %.0f rounds/s\n",
+                          BARRIER_THREADS,
+                          rounds);
+  CSC369_InterruptsPrintf("sleep/wake-one barrier (%d threads): %.0f rounds/s\n",
+                          BARRIER_THREADS,
+                          naive_rounds);
+}
+
+int
+main(void)
+{
+  // Initialize the user-level thread package
+  CSC369_ThreadInit();
+  // Initialize and enable interrupts
+  CSC369_InterruptsInit();
+  // Uninterrupted prints are expensive, keep the interrupts logging quiet
+  CSC369_InterruptsSetLogLevel(CSC369_INTERRUPTS_QUIET);
+
+  run_sync_bench();
+
+  return 0;
+}
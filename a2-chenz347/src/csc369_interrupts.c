@@ -1,6 +1,11 @@
 #include <assert.h>
+#include <errno.h>
 #include <signal.h>
 #include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include <sys/time.h>
 
 #include "csc369_interrupts.h"
@@ -14,6 +19,24 @@
 // Whether we should log debugging information to stdout
 int interrupts_log_level = CSC369_INTERRUPTS_QUIET;
 
+// Nesting depth of CSC369_InterruptsDefer, and whether an interrupt arrived
+// while deferred
+static volatile sig_atomic_t interrupts_deferred = 0;
+static volatile sig_atomic_t interrupts_pending = 0;
+
+// Deterministic scheduling state. Preemption points are numbered from 0 in
+// the order they are reached; a schedule file lists the numbers of the points
+// that preempted, one per line.
+static CSC369_InterruptsMode interrupts_mode = CSC369_INTERRUPTS_TIMER;
+static unsigned long sched_param = 0;
+static uint64_t sched_rng = 0;
+static unsigned long sched_point = 0;
+static unsigned long sched_countdown = 0;
+static FILE* sched_record = NULL;
+static unsigned long* sched_replay = NULL;
+static size_t sched_replay_len = 0;
+static size_t sched_replay_next = 0;
+
 /**
  * Ask the operating system to set an alarm for some time (i.e., SIG_INTERVAL)
  * in the future.
@@ -64,13 +87,256 @@ HandleSignal(int sig, siginfo_t* sip, void* contextVP)
 
   // Set up the next interrupt
   ScheduleAlarmSignal();
+  // The interrupted code cannot be preempted right now, let it yield later
+  if (interrupts_deferred) {
+    interrupts_pending = 1;
+    return;
+  }
   // Yield to "preempt" the current thread and switch to another
   CSC369_ThreadYield();
 }
 
+/**
+ * Block or unblock the interrupt signal.
+ *
+ * @return The state of interrupts before the call to this function.
+ */
+static CSC369_InterruptsState
+SetMask(CSC369_InterruptsState state)
+{
+  sigset_t mask, omask;
+
+  // Create a signal set with only CSC369_INTERRUPTS_SIGNAL_TYPE
+  int ret = sigemptyset(&mask);
+  assert(!ret);
+  ret = sigaddset(&mask, CSC369_INTERRUPTS_SIGNAL_TYPE);
+  assert(!ret);
+
+  // Based on state, block or unblock signals of CSC369_INTERRUPTS_SIGNAL_TYPE
+  if (state) {
+    ret = sigprocmask(SIG_UNBLOCK, &mask, &omask);
+  } else {
+    ret = sigprocmask(SIG_BLOCK, &mask, &omask);
+  }
+  assert(!ret);
+  return (sigismember(&omask, CSC369_INTERRUPTS_SIGNAL_TYPE) ? 0 : 1);
+}
+
+/**
+ * @return whether the interrupt signal is unblocked, without polling.
+ */
+static int
+MaskIsEnabled(void)
+{
+  sigset_t mask;
+  int ret = sigprocmask(0, NULL, &mask);
+  assert(!ret);
+  return (sigismember(&mask, CSC369_INTERRUPTS_SIGNAL_TYPE) ? 0 : 1);
+}
+
+/**
+ * Preempt the running thread from a preemption point. Like HandleSignal, the
+ * yield runs with interrupts disabled, so a preempted thread resumes here
+ * rather than at another point nested inside the yield.
+ */
+static void
+Preempt(void)
+{
+  CSC369_InterruptsState const prev_state = SetMask(CSC369_INTERRUPTS_DISABLED);
+  CSC369_ThreadYield();
+  SetMask(prev_state);
+}
+
+/**
+ * Decide whether the current preemption point preempts, advancing the
+ * schedule.
+ */
+static int
+ShouldPreempt(void)
+{
+  unsigned long const point = sched_point++;
+  int preempt = 0;
+
+  switch (interrupts_mode) {
+    case CSC369_INTERRUPTS_RANDOM:
+      // xorshift64*
+      sched_rng ^= sched_rng >> 12;
+      sched_rng ^= sched_rng << 25;
+      sched_rng ^= sched_rng >> 27;
+      preempt = ((sched_rng * 0x2545F4914F6CDD1DULL) >> 32) % sched_param == 0;
+      break;
+    case CSC369_INTERRUPTS_BUDGET:
+      if (--sched_countdown == 0) {
+        sched_countdown = sched_param;
+        preempt = 1;
+      }
+      break;
+    case CSC369_INTERRUPTS_REPLAY:
+      if (sched_replay_next < sched_replay_len &&
+          sched_replay[sched_replay_next] == point) {
+        sched_replay_next++;
+        preempt = 1;
+      }
+      break;
+    default:
+      break;
+  }
+  if (preempt && sched_record != NULL) {
+    fprintf(sched_record, "%lu\n", point);
+  }
+  return preempt;
+}
+
+static void
+CloseSchedule(void)
+{
+  if (sched_record != NULL) {
+    fclose(sched_record);
+    sched_record = NULL;
+  }
+  if (interrupts_mode == CSC369_INTERRUPTS_REPLAY &&
+      sched_replay_next != sched_replay_len) {
+    fprintf(stderr,
+            "CSC369 schedule replay diverged: %zu of %zu preemptions used\n",
+            sched_replay_next,
+            sched_replay_len);
+  }
+  free(sched_replay);
+  sched_replay = NULL;
+}
+
+void
+CSC369_InterruptsInitDeterministic(CSC369_InterruptsMode mode,
+                                   unsigned long param,
+                                   unsigned long seed,
+                                   const char* schedule)
+{
+  // Ensure interrupts are only initialized once
+  static int init = 0;
+  assert(!init);
+  init = 1;
+  assert(mode != CSC369_INTERRUPTS_TIMER);
+  assert(mode != CSC369_INTERRUPTS_RANDOM || param >= 2);
+  assert(mode != CSC369_INTERRUPTS_BUDGET || param >= 1);
+
+  interrupts_mode = mode;
+  sched_param = param;
+  sched_countdown = param;
+  sched_rng = seed * 0x9E3779B97F4A7C15ULL + 1;
+
+  if (mode == CSC369_INTERRUPTS_REPLAY) {
+    assert(schedule != NULL);
+    FILE* f = fopen(schedule, "r");
+    if (f == NULL) {
+      perror(schedule);
+      exit(1);
+    }
+    size_t capacity = 0;
+    unsigned long point;
+    while (fscanf(f, "%lu", &point) == 1) {
+      if (sched_replay_len == capacity) {
+        capacity = capacity ? capacity * 2 : 1024;
+        sched_replay = realloc(sched_replay, capacity * sizeof(unsigned long));
+        assert(sched_replay != NULL);
+      }
+      sched_replay[sched_replay_len++] = point;
+    }
+    fclose(f);
+  } else if (schedule != NULL) {
+    sched_record = fopen(schedule, "w");
+    if (sched_record == NULL) {
+      perror(schedule);
+      exit(1);
+    }
+  }
+  atexit(CloseSchedule);
+}
+
+CSC369_InterruptsMode
+CSC369_InterruptsGetMode(void)
+{
+  return interrupts_mode;
+}
+
+void
+CSC369_InterruptsPoll(void)
+{
+  if (interrupts_mode == CSC369_INTERRUPTS_TIMER || !MaskIsEnabled() ||
+      !ShouldPreempt()) {
+    return;
+  }
+  if (interrupts_deferred) {
+    interrupts_pending = 1;
+    return;
+  }
+  Preempt();
+}
+
+/*
+ * Returns the number in the environment variable name, or def if it is not
+ * set. Exits with a message if it is set to anything but a number of at least
+ * min.
+ */
+static unsigned long
+GetEnvNumber(char const* name, unsigned long def, unsigned long min)
+{
+  char const* value = getenv(name);
+  if (value == NULL) {
+    return def;
+  }
+  char* end;
+  errno = 0;
+  unsigned long const number = strtoul(value, &end, 10);
+  if (value[0] < '0' || value[0] > '9' || *end != '\0' || errno != 0 ||
+      number < min) {
+    fprintf(stderr,
+            "%s=\"%s\": expected a number of at least %lu\n",
+            name,
+            value,
+            min);
+    exit(1);
+  }
+  return number;
+}
+
 void
 CSC369_InterruptsInit(void)
 {
+  char const* mode = getenv("CSC369_SCHED_MODE");
+  if (mode != NULL && strcmp(mode, "timer") != 0) {
+    CSC369_InterruptsMode sched_mode;
+    unsigned long min_param = 0;
+    if (strcmp(mode, "random") == 0) {
+      sched_mode = CSC369_INTERRUPTS_RANDOM;
+      min_param = 2;
+    } else if (strcmp(mode, "budget") == 0) {
+      sched_mode = CSC369_INTERRUPTS_BUDGET;
+      min_param = 1;
+    } else if (strcmp(mode, "replay") == 0) {
+      sched_mode = CSC369_INTERRUPTS_REPLAY;
+    } else {
+      fprintf(stderr,
+              "CSC369_SCHED_MODE=\"%s\": expected timer, random, budget or "
+              "replay\n",
+              mode);
+      exit(1);
+    }
+
+    char const* schedule = getenv("CSC369_SCHED_FILE");
+    if (sched_mode == CSC369_INTERRUPTS_REPLAY && schedule == NULL) {
+      fprintf(stderr,
+              "CSC369_SCHED_MODE=replay: CSC369_SCHED_FILE must name the "
+              "schedule to replay\n");
+      exit(1);
+    }
+    CSC369_InterruptsInitDeterministic(
+      sched_mode,
+      GetEnvNumber("CSC369_SCHED_PARAM", 100, min_param),
+      GetEnvNumber("CSC369_SCHED_SEED", 0, 0),
+      schedule);
+    return;
+  }
+
   // Ensure this function is only called once
   static int init = 0;
   assert(!init);
@@ -98,22 +364,11 @@ CSC369_InterruptsInit(void)
 CSC369_InterruptsState
 CSC369_InterruptsSet(CSC369_InterruptsState state)
 {
-  sigset_t mask, omask;
-
-  // Create a signal set with only CSC369_INTERRUPTS_SIGNAL_TYPE
-  int ret = sigemptyset(&mask);
-  assert(!ret);
-  ret = sigaddset(&mask, CSC369_INTERRUPTS_SIGNAL_TYPE);
-  assert(!ret);
-
-  // Based on state, block or unblock signals of CSC369_INTERRUPTS_SIGNAL_TYPE
+  CSC369_InterruptsState const prev_state = SetMask(state);
   if (state) {
-    ret = sigprocmask(SIG_UNBLOCK, &mask, &omask);
-  } else {
-    ret = sigprocmask(SIG_BLOCK, &mask, &omask);
+    CSC369_InterruptsPoll();
   }
-  assert(!ret);
-  return (sigismember(&omask, CSC369_INTERRUPTS_SIGNAL_TYPE) ? 0 : 1);
+  return prev_state;
 }
 
 CSC369_InterruptsState
@@ -128,13 +383,26 @@ CSC369_InterruptsDisable(void)
   return CSC369_InterruptsSet(CSC369_INTERRUPTS_DISABLED);
 }
 
+void
+CSC369_InterruptsDefer(void)
+{
+  interrupts_deferred++;
+}
+
+void
+CSC369_InterruptsUndefer(void)
+{
+  assert(interrupts_deferred > 0);
+  if (--interrupts_deferred == 0 && interrupts_pending) {
+    interrupts_pending = 0;
+    Preempt();
+  }
+}
+
 int
 CSC369_InterruptsAreEnabled(void)
 {
-  sigset_t mask;
-  int ret = sigprocmask(0, NULL, &mask);
-  assert(!ret);
-  return (sigismember(&mask, CSC369_INTERRUPTS_SIGNAL_TYPE) ? 0 : 1);
+  return MaskIsEnabled();
 }
 
 void
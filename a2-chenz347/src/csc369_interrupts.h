@@ -22,6 +22,26 @@ typedef enum
   CSC369_INTERRUPTS_ENABLED = 1,
 } CSC369_InterruptsState;
 
+/**
+ * Enum specifying where preemptions come from.
+ *
+ * In the deterministic modes no alarm is scheduled. Instead, the library
+ * offers a preemption point whenever interrupts are re-enabled, whenever
+ * CSC369_InterruptsPoll is called with them enabled, and after every
+ * CSC369_INTERRUPTS_SIGNAL_INTERVAL microseconds of CSC369_ThreadSpin. The mode
+ * decides which of those points preempt the running thread, so a program that
+ * is otherwise deterministic interleaves the same way on every run.
+ */
+typedef enum
+{
+  CSC369_INTERRUPTS_TIMER = 0,  /* SIGALRM every SIGNAL_INTERVAL microseconds */
+  CSC369_INTERRUPTS_RANDOM = 1, /* each point preempts with probability 1/param,
+                                   from a PRNG seeded with the seed */
+  CSC369_INTERRUPTS_BUDGET = 2, /* every param-th point preempts */
+  CSC369_INTERRUPTS_REPLAY = 3, /* the points listed in a recorded schedule
+                                   preempt */
+} CSC369_InterruptsMode;
+
 /**
  * Enum specifying the verbosity of outputs (logging) produced by interrupts.
  */
@@ -41,6 +61,43 @@ typedef enum
 void
 CSC369_InterruptsInit(void);
 
+/**
+ * Initialize the CSC369 interrupt library in a deterministic mode, instead of
+ * CSC369_InterruptsInit.
+ *
+ * CSC369_InterruptsInit does the same when the environment variable
+ * CSC369_SCHED_MODE is "random", "budget" or "replay", taking param from
+ * CSC369_SCHED_PARAM, seed from CSC369_SCHED_SEED and the schedule file from
+ * CSC369_SCHED_FILE. This way existing programs can be run deterministically
+ * without changes.
+ *
+ * @param mode Where preemptions come from.
+ * @param param For CSC369_INTERRUPTS_RANDOM, the inverse of the probability of
+ * preempting at each point (at least 2). For CSC369_INTERRUPTS_BUDGET, the
+ * number of points between preemptions. Ignored otherwise.
+ * @param seed The seed of the PRNG used by CSC369_INTERRUPTS_RANDOM.
+ * @param schedule For CSC369_INTERRUPTS_REPLAY, the schedule to replay. For
+ * the other deterministic modes, the file to record the schedule to, or NULL.
+ */
+void
+CSC369_InterruptsInitDeterministic(CSC369_InterruptsMode mode,
+                                   unsigned long param,
+                                   unsigned long seed,
+                                   const char* schedule);
+
+/**
+ * @return The mode the interrupt library was initialized with.
+ */
+CSC369_InterruptsMode
+CSC369_InterruptsGetMode(void);
+
+/**
+ * A preemption point. In the deterministic modes the running thread may be
+ * preempted here if interrupts are enabled; in timer mode this does nothing.
+ */
+void
+CSC369_InterruptsPoll(void);
+
 /**
  * Set whether interrupts should be enabled or disabled.
  *
@@ -65,6 +122,24 @@ CSC369_InterruptsEnable(void);
 CSC369_InterruptsState
 CSC369_InterruptsDisable(void);
 
+/**
+ * Defer interrupts without making a system call.
+ *
+ * An interrupt that arrives while deferred is recorded rather than delivered,
+ * and the preemption it would have caused happens in the matching call to
+ * CSC369_InterruptsUndefer. Calls may be nested. Deferred code must not
+ * suspend the calling thread.
+ */
+void
+CSC369_InterruptsDefer(void);
+
+/**
+ * End a section started by CSC369_InterruptsDefer, yielding if an interrupt
+ * arrived in the meantime.
+ */
+void
+CSC369_InterruptsUndefer(void);
+
 /**
  * @return whether interrupts are enabled (1) or not (0).
  */
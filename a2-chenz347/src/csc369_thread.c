@@ -39,6 +39,59 @@ typedef enum
   CSC369_THREAD_BLOCKED = 4,		/* Blocking threads */
 } CSC369_ThreadState;
 
+/**
+ * A span of the arena allocator. The header sits at the start of a
+ * CSC369_ARENA_SPAN_SIZE aligned block, so the span owning any block is found
+ * by masking the block's address.
+ */
+#define ARENA_LARGE_CLASS CSC369_ARENA_NUM_CLASSES
+#define ARENA_MIN_BLOCK 16
+
+typedef struct csc369_span_t
+{
+  struct csc369_span_t *next;	/* next span of the owner, or in the pool */
+  struct csc369_span_t *prev;	/* previous large span of the owner */
+  Tid 					owner;		/* thread whose arena holds this span */
+  int 					size_class;	/* block size class, or ARENA_LARGE_CLASS */
+  char 				   *bump;		/* first block never handed out */
+  char 				   *end;		/* end of the usable space */
+} Span;
+
+#define ARENA_SPAN_HEADER ((sizeof(Span) + 15) & ~(size_t)15)
+
+/**
+ * The per-thread cache of the arena allocator.
+ */
+typedef struct
+{
+  void 	*free_list[CSC369_ARENA_NUM_CLASSES];	/* freed blocks, per class */
+  Span 	*current[CSC369_ARENA_NUM_CLASSES];		/* span being carved, per class */
+  Span 	*spans;									/* small spans owned */
+  Span 	*spans_tail;
+  Span 	*large;									/* large spans owned */
+} Arena;
+
+typedef enum
+{
+  CSC369_CO_SUSPENDED = 0,		/* Created or yielded */
+  CSC369_CO_RUNNING = 1,		/* Resumed and not yet yielded */
+  CSC369_CO_FINISHED = 2,		/* Function returned */
+} CSC369_CoState;
+
+/**
+ * A coroutine.
+ */
+typedef struct csc369_coroutine_t
+{
+  volatile CSC369_CoState 	state;
+  ucontext_t 				context;		/* where the coroutine resumes */
+  ucontext_t 				caller_context;	/* where CSC369_CoResume returns */
+  struct csc369_coroutine_t *resumer;		/* coroutine that resumed this one */
+  void 					   *value;			/* last value yielded */
+  void 					  (*f)(void *);
+  void 					   *arg;
+} CSC369_Coroutine;
+
 /**
  * The Thread Control Block.
  */
@@ -61,6 +114,20 @@ typedef struct
   CSC369_WaitQueue  *join_threads;
   void 			    *next;		  
   void 			    *prev;
+  /**
+   * The function the thread was created with, and whether its stack was
+   * painted for profiling.
+   */
+  void 			   (*entry)(void *);
+  int 				 stack_painted;
+  /**
+   * The coroutine this thread is currently running, if any.
+   */
+  CSC369_Coroutine *coroutine;
+  /**
+   * The thread's arena, released in bulk when the thread exits.
+   */
+  Arena 			 arena;
 } TCB;
 
 /**
@@ -89,6 +156,18 @@ static CSC369_WaitQueue ready_threads;
  */
 static CSC369_WaitQueue zombie_threads; 
 
+/**
+ * Stack profiling state, one entry per thread function seen.
+ */
+static int gStackProfile = 0;
+static CSC369_StackStats gStackStats[CSC369_MAX_THREADS];
+static int gStackStatsCount = 0;
+
+/**
+ * The central pool of free spans shared by all arenas.
+ */
+static Span *gSpanPool = NULL;
+
 //**************************************************************************************************
 // Helper Functions
 //**************************************************************************************************
@@ -208,6 +287,39 @@ Queue_Remove(CSC369_WaitQueue* queue, TCB* tcb)
 	return; 
 }
 
+/*
+	Move every thread in queue to the end of the ready queue in one splice,
+	keeping their order. Returns the number of threads moved.
+*/
+static int 
+Queue_WakeBatch(CSC369_WaitQueue* queue)
+{
+	assert(queue != NULL);
+	CSC369_InterruptsState const prev_state = CSC369_InterruptsDisable();
+	TCB *first = queue->head;
+	if (first == NULL) {
+		CSC369_InterruptsSet(prev_state);
+		return 0;
+	}
+	int wake_num = 0;
+	for (TCB *temp = first; temp != NULL; temp = temp->next) {
+		temp->thread_state = CSC369_THREAD_READY;
+		wake_num++;
+	}
+	queue->head = NULL;
+	if (ready_threads.head == NULL) {
+		ready_threads.head = first;
+	} else {
+		TCB *tail = ready_threads.head;
+		while (tail->next != NULL)
+			tail = tail->next;
+		tail->next = first;
+		first->prev = tail;
+	}
+	CSC369_InterruptsSet(prev_state);
+	return wake_num;
+}
+
 static TCB *findNewTcb()
 {
 	CSC369_InterruptsState const prev_state = CSC369_InterruptsDisable();
@@ -253,10 +365,92 @@ int my_makecontext(ucontext_t *ucp,void(*func)(void),int arg_num,void *arg_1,voi
 	return 0;
 }
 
+/*
+	Record how much of a painted stack was used, scanning up from the lowest
+	address for the first byte that no longer holds the paint.
+*/
+static void Stack_Measure(TCB *tcb)
+{
+	if (!tcb->stack_painted || tcb->user_level_context.uc_stack.ss_sp == NULL)
+		return;
+	tcb->stack_painted = 0;
+	const uint64_t paint = 0x0101010101010101ULL * CSC369_STACK_PAINT;
+	const uint64_t *word = tcb->user_level_context.uc_stack.ss_sp;
+	size_t words = CSC369_THREAD_STACK_SIZE / sizeof(uint64_t);
+	size_t untouched = 0;
+	while (untouched < words && word[untouched] == paint)
+		untouched++;
+	size_t used = CSC369_THREAD_STACK_SIZE - untouched * sizeof(uint64_t);
+
+	CSC369_StackStats *stats = NULL;
+	for (int i = 0; i < gStackStatsCount; i++) {
+		if (gStackStats[i].f == tcb->entry) {
+			stats = &gStackStats[i];
+			break;
+		}
+	}
+	if (stats == NULL) {
+		if (gStackStatsCount == CSC369_MAX_THREADS)
+			return;
+		stats = &gStackStats[gStackStatsCount++];
+		memset(stats,0,sizeof(CSC369_StackStats));
+		stats->f = tcb->entry;
+	}
+	stats->threads++;
+	stats->total_used += used;
+	if (used > stats->max_used)
+		stats->max_used = used;
+}
+
+/*
+	Take a span from the central pool, or from the system when it is empty.
+	Must be called with interrupts deferred or disabled.
+*/
+static Span *Arena_NewSpan(Tid owner, int size_class, size_t bytes)
+{
+	Span *span = NULL;
+	if (size_class != ARENA_LARGE_CLASS && gSpanPool != NULL) {
+		span = gSpanPool;
+		gSpanPool = span->next;
+	} else {
+		span = aligned_alloc(CSC369_ARENA_SPAN_SIZE, bytes);
+		if (span == NULL)
+			return NULL;
+	}
+	span->next = NULL;
+	span->prev = NULL;
+	span->owner = owner;
+	span->size_class = size_class;
+	span->bump = (char *)span + ARENA_SPAN_HEADER;
+	span->end = (char *)span + bytes;
+	return span;
+}
+
+/*
+	Release everything in an arena: small spans go back to the central pool in
+	one splice, large spans go back to the system.
+*/
+static void Arena_Release(Arena *arena)
+{
+	CSC369_InterruptsDefer();
+	if (arena->spans != NULL) {
+		arena->spans_tail->next = gSpanPool;
+		gSpanPool = arena->spans;
+	}
+	while (arena->large != NULL) {
+		Span *next = arena->large->next;
+		free(arena->large);
+		arena->large = next;
+	}
+	memset(arena, 0, sizeof(Arena));
+	CSC369_InterruptsUndefer();
+}
+
 void my_on_exit()
 {
 	CSC369_InterruptsDisable();
 	for (int i = 0;i < CSC369_MAX_THREADS;i++) {
+		Arena_Release(&gThreadTotal[i].arena);
 		if (gThreadTotal[i].user_level_context.uc_stack.ss_sp != NULL) {
 			#ifdef DEBUG_USE_VALGRIND
 				VALGRIND_STACK_DEREGISTER(gThreadTotal[i].user_level_context.uc_stack.ss_sp);
@@ -272,6 +466,11 @@ void my_on_exit()
 			gThreadTotal[i].join_threads = NULL;
 		}
 	}
+	while (gSpanPool != NULL) {
+		Span *next = gSpanPool->next;
+		free(gSpanPool);
+		gSpanPool = next;
+	}
 }
 
 
@@ -293,6 +492,10 @@ CSC369_ThreadInit(void)
 		gThreadTotal[i].prev = NULL;
 		gThreadTotal[i].join_threads = NULL;
 		gThreadTotal[i].exit_code = 0;
+		gThreadTotal[i].entry = NULL;
+		gThreadTotal[i].stack_painted = 0;
+		gThreadTotal[i].coroutine = NULL;
+		memset(&gThreadTotal[i].arena,0,sizeof(Arena));
 	}
 	/*
 		Create the 0th thread and set current running thread to #0
@@ -347,11 +550,16 @@ CSC369_ThreadCreate(void (*f)(void*), void* arg)
 		tcb_ptr->user_level_context.uc_stack.ss_sp = NULL;
 	}
 	/* Dynamically allocate a stack */
-	char *stack = calloc(1,CSC369_THREAD_STACK_SIZE);
+	char *stack = gStackProfile ? malloc(CSC369_THREAD_STACK_SIZE)
+								: calloc(1,CSC369_THREAD_STACK_SIZE);
 	if (stack == NULL) {
 		CSC369_InterruptsSet(prev_state);
 		return CSC369_ERROR_SYS_MEM;
 	}
+	if (gStackProfile)
+		memset(stack,CSC369_STACK_PAINT,CSC369_THREAD_STACK_SIZE);
+	tcb_ptr->entry = f;
+	tcb_ptr->stack_painted = gStackProfile;
 	#ifdef DEBUG_USE_VALGRIND
 		VALGRIND_STACK_REGISTER(stack,stack+CSC369_THREAD_STACK_SIZE);
 	#endif
@@ -364,6 +572,7 @@ CSC369_ThreadCreate(void (*f)(void*), void* arg)
 	}
 	tcb_ptr->join_threads = CSC369_WaitQueueCreate();
 	Queue_Init(tcb_ptr->join_threads);
+	tcb_ptr->coroutine = NULL;
 	
 	tcb_ptr->user_level_context.uc_stack.ss_sp = stack;
 	tcb_ptr->user_level_context.uc_stack.ss_size = CSC369_THREAD_STACK_SIZE;
@@ -390,6 +599,8 @@ CSC369_ThreadExit(int exit_code)
 		gThreadTotal[tid].thread_state = CSC369_THREAD_FREE;
 		gThreadTotal[tid].exit_code = exit_code;
 		gThreadRunningHead = NULL;
+		Stack_Measure(&gThreadTotal[tid]);
+		Arena_Release(&gThreadTotal[tid].arena);
 	}
 	/* Check if any thread is waiting on this one */
 	if(Queue_IsEmpty(gThreadTotal[tid].join_threads)) {
@@ -457,6 +668,7 @@ CSC369_ThreadKill(Tid tid)
 			MYPRINTF(("CSC369_ThreadKill_4 gThreadTotal[%d].thread_state:%d gContinue:%d\n",tid,gThreadTotal[tid].thread_state,gContinue++));
 			/* Put in zombie queue */
 			Queue_Enqueue(&zombie_threads, &gThreadTotal[tid]);
+			Stack_Measure(&gThreadTotal[tid]);
 			MYPRINTF(("CSC369_ThreadKill_5 gThreadTotal[%d].thread_state:%d gContinue:%d\n",tid,gThreadTotal[tid].thread_state,gContinue++));
 			if (gThreadTotal[tid].user_level_context.uc_stack.ss_sp != NULL){
 				#ifdef DEBUG_USE_VALGRIND
@@ -465,6 +677,7 @@ CSC369_ThreadKill(Tid tid)
 				free(gThreadTotal[tid].user_level_context.uc_stack.ss_sp);
 				gThreadTotal[tid].user_level_context.uc_stack.ss_sp = NULL;
 			}
+			Arena_Release(&gThreadTotal[tid].arena);
 			gThreadTotal[tid].thread_state = CSC369_THREAD_ZOMBIE;
 			gThreadTotal[tid].exit_code = CSC369_EXIT_CODE_KILL;
 			CSC369_InterruptsSet(prev_state);
@@ -491,6 +704,7 @@ CSC369_ThreadKill(Tid tid)
 			
 			/* Put in zombie queue */
 			Queue_Enqueue(&zombie_threads, &gThreadTotal[tid]);
+			Stack_Measure(&gThreadTotal[tid]);
 			if (gThreadTotal[tid].user_level_context.uc_stack.ss_sp != NULL){
 				#ifdef DEBUG_USE_VALGRIND
 					VALGRIND_STACK_DEREGISTER(gThreadTotal[tid].user_level_context.uc_stack.ss_sp);
@@ -498,6 +712,7 @@ CSC369_ThreadKill(Tid tid)
 				free(gThreadTotal[tid].user_level_context.uc_stack.ss_sp);
 				gThreadTotal[tid].user_level_context.uc_stack.ss_sp = NULL;
 			}
+			Arena_Release(&gThreadTotal[tid].arena);
 			gThreadTotal[tid].thread_state = CSC369_THREAD_ZOMBIE;
 			gThreadTotal[tid].exit_code = CSC369_EXIT_CODE_KILL;
 			CSC369_InterruptsSet(prev_state);
@@ -638,6 +853,24 @@ CSC369_ThreadSpin(int duration)
 {
   struct timeval start, end, diff;
 
+  if (CSC369_InterruptsGetMode() != CSC369_INTERRUPTS_TIMER) {
+    /* Spin in fixed slices of running time, offering a preemption point after
+       each, so the number of points does not depend on the wall clock */
+    for (int spun = 0; spun < duration; spun += CSC369_INTERRUPTS_SIGNAL_INTERVAL) {
+      int const slice = duration - spun < CSC369_INTERRUPTS_SIGNAL_INTERVAL ?
+                        duration - spun : CSC369_INTERRUPTS_SIGNAL_INTERVAL;
+      int ret = gettimeofday(&start, NULL);
+      assert(!ret);
+      do {
+        ret = gettimeofday(&end, NULL);
+        assert(!ret);
+        timersub(&end, &start, &diff);
+      } while ((diff.tv_sec * 1000000 + diff.tv_usec) < slice);
+      CSC369_InterruptsPoll();
+    }
+    return;
+  }
+
   int ret = gettimeofday(&start, NULL);
   assert(!ret);
 
@@ -703,19 +936,7 @@ int
 CSC369_ThreadWakeAll(CSC369_WaitQueue* queue)
 {
 	assert(queue != NULL);
-	TCB* wakeup = NULL;
-	int wake_num = 0;
-	CSC369_InterruptsState const prev_state = CSC369_InterruptsDisable();
-	do {
-		if(Queue_IsEmpty(queue))
-			break;
-		wakeup = Queue_Dequeue(queue);
-		wakeup->thread_state = CSC369_THREAD_READY;
-		Queue_Enqueue(&ready_threads,wakeup);
-		wake_num++;
-	} while(wake_num < CSC369_MAX_THREADS);
-	CSC369_InterruptsSet(prev_state);
-	return wake_num;
+	return Queue_WakeBatch(queue);
 }
 
 //****************************************************************************
@@ -772,3 +993,401 @@ CSC369_ThreadJoin(Tid tid, int* exit_code)
 	CSC369_InterruptsSet(prev_state);
     return CSC369_ERROR_TID_INVALID;
 }
+
+//****************************************************************************
+// Reader-Writer Locks and Barriers
+//****************************************************************************
+/**
+ * A reader-writer lock. readers and writer count the current holders,
+ * including threads that were handed the lock but have not run yet.
+ */
+typedef struct csc369_rwlock_t
+{
+  int 				readers;
+  int 				writer;
+  int 				waiting_writers;
+  CSC369_WaitQueue 	read_waiters;
+  CSC369_WaitQueue 	write_waiters;
+} CSC369_RwLock;
+
+/**
+ * A barrier. The generation is the barrier's sense: it changes exactly once
+ * per round, and a sleeper only leaves once it has changed.
+ */
+typedef struct csc369_barrier_t
+{
+  int 				count;
+  int 				arrived;
+  unsigned int 		generation;
+  CSC369_WaitQueue 	waiters;
+} CSC369_Barrier;
+
+CSC369_RwLock*
+CSC369_RwLockCreate(void)
+{
+	CSC369_InterruptsState const prev_state = CSC369_InterruptsDisable();
+	CSC369_RwLock *lock = calloc(1,sizeof(CSC369_RwLock));
+	CSC369_InterruptsSet(prev_state);
+	if (lock != NULL) {
+		Queue_Init(&lock->read_waiters);
+		Queue_Init(&lock->write_waiters);
+	}
+	return lock;
+}
+
+int
+CSC369_RwLockDestroy(CSC369_RwLock* lock)
+{
+	assert(lock != NULL);
+	CSC369_InterruptsState const prev_state = CSC369_InterruptsDisable();
+	if (lock->readers != 0 || lock->writer || lock->waiting_writers != 0 ||
+		!Queue_IsEmpty(&lock->read_waiters)) {
+		CSC369_InterruptsSet(prev_state);
+		return CSC369_ERROR_OTHER;
+	}
+	free(lock);
+	CSC369_InterruptsSet(prev_state);
+	return 0;
+}
+
+int
+CSC369_RwLockRead(CSC369_RwLock* lock)
+{
+	assert(lock != NULL);
+	CSC369_InterruptsState const prev_state = CSC369_InterruptsDisable();
+	if (!lock->writer && lock->waiting_writers == 0) {
+		lock->readers++;
+		CSC369_InterruptsSet(prev_state);
+		return 0;
+	}
+	/* The releasing writer counts us in before waking us */
+	int ret = CSC369_ThreadSleep(&lock->read_waiters);
+	CSC369_InterruptsSet(prev_state);
+	return ret < 0 ? ret : 0;
+}
+
+int
+CSC369_RwLockWrite(CSC369_RwLock* lock)
+{
+	assert(lock != NULL);
+	CSC369_InterruptsState const prev_state = CSC369_InterruptsDisable();
+	if (!lock->writer && lock->readers == 0) {
+		lock->writer = 1;
+		CSC369_InterruptsSet(prev_state);
+		return 0;
+	}
+	lock->waiting_writers++;
+	/* The releasing holder makes us the writer before waking us */
+	int ret = CSC369_ThreadSleep(&lock->write_waiters);
+	if (ret < 0)
+		lock->waiting_writers--;
+	CSC369_InterruptsSet(prev_state);
+	return ret < 0 ? ret : 0;
+}
+
+void
+CSC369_RwLockUnlock(CSC369_RwLock* lock)
+{
+	assert(lock != NULL);
+	CSC369_InterruptsState const prev_state = CSC369_InterruptsDisable();
+	if (lock->writer) {
+		lock->writer = 0;
+	} else {
+		assert(lock->readers > 0);
+		lock->readers--;
+	}
+	if (lock->readers == 0 && lock->waiting_writers > 0) {
+		lock->waiting_writers--;
+		lock->writer = 1;
+		CSC369_ThreadWakeNext(&lock->write_waiters);
+	} else if (!lock->writer && lock->waiting_writers == 0) {
+		lock->readers += Queue_WakeBatch(&lock->read_waiters);
+	}
+	CSC369_InterruptsSet(prev_state);
+}
+
+CSC369_Barrier*
+CSC369_BarrierCreate(int count)
+{
+	if (count <= 0)
+		return NULL;
+	CSC369_InterruptsState const prev_state = CSC369_InterruptsDisable();
+	CSC369_Barrier *barrier = calloc(1,sizeof(CSC369_Barrier));
+	CSC369_InterruptsSet(prev_state);
+	if (barrier != NULL) {
+		barrier->count = count;
+		Queue_Init(&barrier->waiters);
+	}
+	return barrier;
+}
+
+int
+CSC369_BarrierDestroy(CSC369_Barrier* barrier)
+{
+	assert(barrier != NULL);
+	CSC369_InterruptsState const prev_state = CSC369_InterruptsDisable();
+	if (!Queue_IsEmpty(&barrier->waiters)) {
+		CSC369_InterruptsSet(prev_state);
+		return CSC369_ERROR_OTHER;
+	}
+	free(barrier);
+	CSC369_InterruptsSet(prev_state);
+	return 0;
+}
+
+int
+CSC369_BarrierWait(CSC369_Barrier* barrier)
+{
+	assert(barrier != NULL);
+	CSC369_InterruptsState const prev_state = CSC369_InterruptsDisable();
+	if (++barrier->arrived == barrier->count) {
+		/* Last to arrive: flip the sense and release the round */
+		barrier->arrived = 0;
+		barrier->generation++;
+		Queue_WakeBatch(&barrier->waiters);
+		CSC369_InterruptsSet(prev_state);
+		return CSC369_BARRIER_SERIAL_THREAD;
+	}
+	unsigned int const generation = barrier->generation;
+	while (barrier->generation == generation) {
+		int ret = CSC369_ThreadSleep(&barrier->waiters);
+		if (ret < 0) {
+			barrier->arrived--;
+			CSC369_InterruptsSet(prev_state);
+			return ret;
+		}
+	}
+	CSC369_InterruptsSet(prev_state);
+	return 0;
+}
+
+//****************************************************************************
+// Stack Profiling
+//****************************************************************************
+void
+CSC369_StackProfileEnable(int enable)
+{
+	gStackProfile = enable;
+}
+
+int
+CSC369_StackProfileGet(CSC369_StackStats* stats, int max)
+{
+	CSC369_InterruptsState const prev_state = CSC369_InterruptsDisable();
+	int count = gStackStatsCount < max ? gStackStatsCount : max;
+	memcpy(stats,gStackStats,count * sizeof(CSC369_StackStats));
+	CSC369_InterruptsSet(prev_state);
+	return count;
+}
+
+void
+CSC369_StackProfileReport(void)
+{
+	CSC369_StackStats stats[CSC369_MAX_THREADS];
+	int count = CSC369_StackProfileGet(stats,CSC369_MAX_THREADS);
+	CSC369_InterruptsPrintf("%-18s %8s %10s %10s %10s\n",
+							"function","threads","max","mean","of");
+	for (int i = 0; i < count; i++) {
+		CSC369_InterruptsPrintf("%-18p %8d %10zu %10zu %10d\n",
+								(void *)stats[i].f,stats[i].threads,
+								stats[i].max_used,
+								stats[i].total_used / stats[i].threads,
+								CSC369_THREAD_STACK_SIZE);
+	}
+}
+
+//****************************************************************************
+// Coroutines
+//****************************************************************************
+/*
+	Every switch between a coroutine and its resumer happens with interrupts
+	deferred, and the side that is switched to ends the deferral. A preemption
+	that lands inside the coroutine saves the thread's context on the
+	coroutine's stack, which is where the thread is running.
+*/
+static void 
+MyCoStub(CSC369_Coroutine *co, void *unused)
+{
+	(void)unused;
+	CSC369_InterruptsUndefer();
+	co->f(co->arg);
+	CSC369_InterruptsDefer();
+	gThreadRunningHead->coroutine = co->resumer;
+	co->state = CSC369_CO_FINISHED;
+	setcontext(&co->caller_context);
+	/* Can't get here */
+}
+
+CSC369_Coroutine*
+CSC369_CoCreate(void (*f)(void*), void* arg)
+{
+	CSC369_InterruptsDefer();
+	CSC369_Coroutine *co = calloc(1,sizeof(CSC369_Coroutine));
+	char *stack = calloc(1,CSC369_THREAD_STACK_SIZE);
+	CSC369_InterruptsUndefer();
+	if (co == NULL || stack == NULL) {
+		CSC369_InterruptsDefer();
+		free(co);
+		free(stack);
+		CSC369_InterruptsUndefer();
+		return NULL;
+	}
+	#ifdef DEBUG_USE_VALGRIND
+		VALGRIND_STACK_REGISTER(stack,stack+CSC369_THREAD_STACK_SIZE);
+	#endif
+	co->state = CSC369_CO_SUSPENDED;
+	co->f = f;
+	co->arg = arg;
+	getcontext(&co->context);
+	co->context.uc_stack.ss_sp = stack;
+	co->context.uc_stack.ss_size = CSC369_THREAD_STACK_SIZE;
+	co->context.uc_stack.ss_flags = 0;
+	co->context.uc_link = NULL;
+	my_makecontext(&co->context,(void*)MyCoStub,2,co,NULL);
+	return co;
+}
+
+int
+CSC369_CoResume(CSC369_Coroutine* co, void** value)
+{
+	assert(co != NULL);
+	CSC369_InterruptsDefer();
+	if (co->state != CSC369_CO_SUSPENDED) {
+		CSC369_InterruptsUndefer();
+		return CSC369_ERROR_THREAD_BAD;
+	}
+	co->state = CSC369_CO_RUNNING;
+	co->resumer = gThreadRunningHead->coroutine;
+	gThreadRunningHead->coroutine = co;
+	getcontext(&co->caller_context);
+	if (co->state == CSC369_CO_RUNNING) {
+		setcontext(&co->context);
+	}
+	/* Back from CSC369_CoYield or MyCoStub, still deferred */
+	CSC369_InterruptsUndefer();
+	if (co->state == CSC369_CO_FINISHED)
+		return 0;
+	if (value != NULL)
+		*value = co->value;
+	return 1;
+}
+
+void
+CSC369_CoYield(void* value)
+{
+	CSC369_InterruptsDefer();
+	CSC369_Coroutine *co = gThreadRunningHead->coroutine;
+	assert(co != NULL);
+	gThreadRunningHead->coroutine = co->resumer;
+	co->value = value;
+	co->state = CSC369_CO_SUSPENDED;
+	getcontext(&co->context);
+	if (co->state == CSC369_CO_SUSPENDED) {
+		setcontext(&co->caller_context);
+	}
+	/* Resumed again, CSC369_CoResume left interrupts deferred */
+	CSC369_InterruptsUndefer();
+}
+
+int
+CSC369_CoDestroy(CSC369_Coroutine* co)
+{
+	assert(co != NULL);
+	CSC369_InterruptsDefer();
+	if (co->state == CSC369_CO_RUNNING) {
+		CSC369_InterruptsUndefer();
+		return CSC369_ERROR_THREAD_BAD;
+	}
+	#ifdef DEBUG_USE_VALGRIND
+		VALGRIND_STACK_DEREGISTER(co->context.uc_stack.ss_sp);
+	#endif
+	free(co->context.uc_stack.ss_sp);
+	free(co);
+	CSC369_InterruptsUndefer();
+	return 0;
+}
+
+//****************************************************************************
+// Arena Allocator
+//****************************************************************************
+void*
+CSC369_Alloc(size_t size)
+{
+	if (size == 0)
+		return NULL;
+	CSC369_InterruptsDefer();
+	if (gThreadRunningHead == NULL) {
+		CSC369_InterruptsUndefer();
+		return NULL;
+	}
+	Tid tid = gThreadRunningHead->id;
+	Arena *arena = &gThreadTotal[tid].arena;
+	void *block = NULL;
+	if (size > (size_t)ARENA_MIN_BLOCK << (CSC369_ARENA_NUM_CLASSES - 1)) {
+		/* Large block: a span of its own, rounded up to whole spans */
+		size_t bytes = (ARENA_SPAN_HEADER + size + CSC369_ARENA_SPAN_SIZE - 1) &
+			~(size_t)(CSC369_ARENA_SPAN_SIZE - 1);
+		Span *span = Arena_NewSpan(tid, ARENA_LARGE_CLASS, bytes);
+		if (span != NULL) {
+			span->next = arena->large;
+			if (arena->large != NULL)
+				arena->large->prev = span;
+			arena->large = span;
+			block = (char *)span + ARENA_SPAN_HEADER;
+		}
+		CSC369_InterruptsUndefer();
+		return block;
+	}
+	int size_class = 0;
+	while (((size_t)ARENA_MIN_BLOCK << size_class) < size)
+		size_class++;
+	size_t block_size = (size_t)ARENA_MIN_BLOCK << size_class;
+
+	if (arena->free_list[size_class] != NULL) {
+		/* Fast path: reuse a freed block */
+		block = arena->free_list[size_class];
+		arena->free_list[size_class] = *(void **)block;
+	} else {
+		Span *span = arena->current[size_class];
+		if (span == NULL || span->bump + block_size > span->end) {
+			span = Arena_NewSpan(tid, size_class, CSC369_ARENA_SPAN_SIZE);
+			if (span != NULL) {
+				if (arena->spans == NULL)
+					arena->spans_tail = span;
+				span->next = arena->spans;
+				arena->spans = span;
+				arena->current[size_class] = span;
+			}
+		}
+		if (span != NULL) {
+			block = span->bump;
+			span->bump += block_size;
+		}
+	}
+	CSC369_InterruptsUndefer();
+	return block;
+}
+
+void
+CSC369_Free(void* ptr)
+{
+	if (ptr == NULL)
+		return;
+	CSC369_InterruptsDefer();
+	Span *span = (Span *)((uintptr_t)ptr & ~(uintptr_t)(CSC369_ARENA_SPAN_SIZE - 1));
+	Arena *arena = &gThreadTotal[span->owner].arena;
+	if (span->size_class == ARENA_LARGE_CLASS) {
+		if (span->prev != NULL)
+			span->prev->next = span->next;
+		else
+			arena->large = span->next;
+		if (span->next != NULL)
+			span->next->prev = span->prev;
+		free(span);
+	} else {
+		/* Blocks freed by another thread go back to the owner's cache */
+		*(void **)ptr = arena->free_list[span->size_class];
+		arena->free_list[span->size_class] = ptr;
+	}
+	CSC369_InterruptsUndefer();
+}
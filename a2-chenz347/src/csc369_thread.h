@@ -6,6 +6,8 @@
 #ifndef CSC369_THREAD_H
 #define CSC369_THREAD_H
 
+#include <stddef.h>
+
 /**
  * Error codes for the CSC369 Thread Library
  */
@@ -268,4 +270,295 @@ CSC369_ThreadWakeAll(CSC369_WaitQueue* queue);
 int
 CSC369_ThreadJoin(Tid tid, int* exit_code);
 
+//****************************************************************************
+// Reader-Writer Locks and Barriers
+//****************************************************************************
+/**
+ * A writer-preferring reader-writer lock. Once a writer is waiting, new
+ * readers wait too. Ownership is handed directly to the threads that are
+ * woken, so they never wake up only to find the lock taken again.
+ */
+typedef struct csc369_rwlock_t CSC369_RwLock;
+
+/**
+ * Create an unlocked reader-writer lock.
+ *
+ * The lock created by this function must be freed using
+ * CSC369_RwLockDestroy.
+ *
+ * @return If successful, a pointer to the new lock. Otherwise, NULL.
+ */
+CSC369_RwLock*
+CSC369_RwLockCreate(void);
+
+/**
+ * Destroy the lock, freeing up allocated memory.
+ *
+ *  This function may fail if:
+ *  - the lock is held or has waiters (CSC369_ERROR_OTHER)
+ *
+ *  @return If successful, 0. Otherwise, the appropriate error code.
+ *
+ *  @pre lock is not NULL
+ */
+int
+CSC369_RwLockDestroy(CSC369_RwLock* lock);
+
+/**
+ * Acquire the lock for reading, sleeping while a writer holds it or is
+ * waiting for it.
+ *
+ *  This function may fail if:
+ *  - the caller would sleep but no other thread can run
+ * (CSC369_ERROR_SYS_THREAD)
+ *
+ * @return If successful, 0. Otherwise, the appropriate error code.
+ *
+ * @pre lock is not NULL
+ */
+int
+CSC369_RwLockRead(CSC369_RwLock* lock);
+
+/**
+ * Acquire the lock for writing, sleeping while any other thread holds it.
+ *
+ *  This function may fail if:
+ *  - the caller would sleep but no other thread can run
+ * (CSC369_ERROR_SYS_THREAD)
+ *
+ * @return If successful, 0. Otherwise, the appropriate error code.
+ *
+ * @pre lock is not NULL
+ */
+int
+CSC369_RwLockWrite(CSC369_RwLock* lock);
+
+/**
+ * Release the lock, held for reading or for writing by the caller.
+ *
+ * A releasing writer hands the lock to the next waiting writer if there is
+ * one, otherwise to every waiting reader at once. The last releasing reader
+ * hands the lock to the next waiting writer.
+ *
+ * @pre lock is not NULL and is held by the caller
+ */
+void
+CSC369_RwLockUnlock(CSC369_RwLock* lock);
+
+/**
+ * A reusable barrier for a fixed number of threads.
+ */
+typedef struct csc369_barrier_t CSC369_Barrier;
+
+/**
+ * The value CSC369_BarrierWait returns to exactly one thread per round.
+ */
+#define CSC369_BARRIER_SERIAL_THREAD 1
+
+/**
+ * Create a barrier for count threads.
+ *
+ * The barrier created by this function must be freed using
+ * CSC369_BarrierDestroy.
+ *
+ * @return If successful, a pointer to the new barrier. Otherwise, NULL.
+ */
+CSC369_Barrier*
+CSC369_BarrierCreate(int count);
+
+/**
+ * Destroy the barrier, freeing up allocated memory.
+ *
+ *  This function may fail if:
+ *  - threads are waiting at the barrier (CSC369_ERROR_OTHER)
+ *
+ *  @return If successful, 0. Otherwise, the appropriate error code.
+ *
+ *  @pre barrier is not NULL
+ */
+int
+CSC369_BarrierDestroy(CSC369_Barrier* barrier);
+
+/**
+ * Sleep until count threads have called this function for the current round.
+ * The last thread to arrive wakes the others as one batch and starts the next
+ * round.
+ *
+ *  This function may fail if:
+ *  - the caller would sleep but no other thread can run
+ * (CSC369_ERROR_SYS_THREAD)
+ *
+ * @return CSC369_BARRIER_SERIAL_THREAD for the last thread to arrive, 0 for
+ * the others. Otherwise, the appropriate error code.
+ *
+ * @pre barrier is not NULL
+ */
+int
+CSC369_BarrierWait(CSC369_Barrier* barrier);
+
+//****************************************************************************
+// Stack Profiling
+//****************************************************************************
+/**
+ * The byte that stacks are painted with while stack profiling is enabled.
+ */
+#define CSC369_STACK_PAINT 0xA5
+
+/**
+ * Stack usage of all profiled threads that ran the same function.
+ */
+typedef struct
+{
+  void (*f)(void*);  /* the function passed to CSC369_ThreadCreate */
+  int threads;       /* threads measured */
+  size_t max_used;   /* deepest stack usage seen, in bytes */
+  size_t total_used; /* sum of the stack usage of all measured threads */
+} CSC369_StackStats;
+
+/**
+ * Enable or disable stack profiling.
+ *
+ * While enabled, the stack of each new thread is painted with
+ * CSC369_STACK_PAINT. When a painted thread exits or is killed, its stack is
+ * scanned for the deepest byte that was overwritten, and the result is added
+ * to the statistics of the thread's function.
+ *
+ * @param enable Whether threads created from now on should be profiled.
+ */
+void
+CSC369_StackProfileEnable(int enable);
+
+/**
+ * Copy the stack statistics gathered so far, one entry per thread function.
+ *
+ * @param stats Where to store the statistics.
+ * @param max The number of entries stats can hold.
+ *
+ * @return The number of entries stored.
+ */
+int
+CSC369_StackProfileGet(CSC369_StackStats* stats, int max);
+
+/**
+ * Print the stack statistics gathered so far to stdout.
+ */
+void
+CSC369_StackProfileReport(void);
+
+//****************************************************************************
+// Coroutines
+//****************************************************************************
+/**
+ * An asymmetric coroutine. A coroutine runs on its own stack inside whichever
+ * thread resumes it, and only ever switches back to that resumer. Coroutines
+ * are never placed on the ready queue.
+ */
+typedef struct csc369_coroutine_t CSC369_Coroutine;
+
+/**
+ * Create a suspended coroutine that runs the function f with the argument arg
+ * when first resumed.
+ *
+ * The coroutine created by this function must be freed using
+ * CSC369_CoDestroy.
+ *
+ * @param f A pointer to the function that this coroutine will execute.
+ * @param arg The argument passed to f.
+ *
+ * @return If successful, a pointer to the new coroutine. Otherwise, NULL.
+ */
+CSC369_Coroutine*
+CSC369_CoCreate(void (*f)(void*), void* arg);
+
+/**
+ * Run the coroutine co until it yields or returns.
+ *
+ * This function may fail if:
+ *  - the coroutine is running or has already returned
+ * (CSC369_ERROR_THREAD_BAD)
+ *
+ * @param co The coroutine to run.
+ * @param value Where to store the value passed to CSC369_CoYield. May be NULL.
+ *
+ * @return 1 if the coroutine yielded, 0 if it returned. Otherwise, the
+ * appropriate error code.
+ *
+ * @pre co is not NULL
+ */
+int
+CSC369_CoResume(CSC369_Coroutine* co, void** value);
+
+/**
+ * Suspend the calling coroutine and return value to its resumer. Returns when
+ * the coroutine is resumed again.
+ *
+ * @param value The value to hand to the resumer.
+ *
+ * @pre The caller is running inside a coroutine.
+ */
+void
+CSC369_CoYield(void* value);
+
+/**
+ * Destroy the coroutine, freeing up its stack.
+ *
+ * A coroutine that has not returned is simply discarded; it never runs again.
+ *
+ * This function may fail if:
+ *  - the coroutine is running (CSC369_ERROR_THREAD_BAD)
+ *
+ * @return If successful, 0. Otherwise, the appropriate error code.
+ *
+ * @pre co is not NULL
+ */
+int
+CSC369_CoDestroy(CSC369_Coroutine* co);
+
+//****************************************************************************
+// Arena Allocator
+//****************************************************************************
+/**
+ * The size, in bytes, of a span. Each thread carves its small allocations out
+ * of spans taken from a central pool, one span per size class at a time.
+ */
+#define CSC369_ARENA_SPAN_SIZE 8192
+
+/**
+ * The number of small size classes. Class c holds blocks of (16 << c) bytes,
+ * so requests of up to 2048 bytes are served from spans. Larger requests get
+ * a span of their own.
+ */
+#define CSC369_ARENA_NUM_CLASSES 8
+
+/**
+ * Allocate size bytes from the calling thread's arena.
+ *
+ * The memory is 16-byte aligned and uninitialized. Allocation is safe to call
+ * with interrupts enabled: preemption is deferred rather than disabled, so no
+ * system call is made unless a span has to be taken from the central pool.
+ *
+ * Everything the thread allocated is released in bulk when the thread exits
+ * or is killed, whether or not it was passed to CSC369_Free.
+ *
+ * @param size The number of bytes to allocate.
+ *
+ * @return A pointer to the allocated memory, or NULL if size is 0, there is
+ * no running thread (before CSC369_ThreadInit or after the last thread
+ * exited), or there is no more memory available.
+ */
+void*
+CSC369_Alloc(size_t size);
+
+/**
+ * Return memory obtained from CSC369_Alloc to the arena of the thread that
+ * allocated it. Passing NULL does nothing.
+ *
+ * @param ptr The memory to free.
+ *
+ * @pre ptr is NULL or was returned by CSC369_Alloc in a thread that has not
+ * exited since
+ */
+void
+CSC369_Free(void* ptr);
+
 #endif /* CSC369_THREAD_H */
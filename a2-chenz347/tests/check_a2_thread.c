@@ -1,6 +1,10 @@
 #include "check.h"
 
+#include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <unistd.h>
 
 #include "csc369_interrupts.h"
 #include "csc369_thread.h"
@@ -27,6 +31,118 @@ f_factorial(int n)
   return n * f_factorial(n - 1);
 }
 
+void* allocated_block;
+
+void
+f_alloc_and_exit(size_t size)
+{
+  allocated_block = CSC369_Alloc(size);
+  ck_assert(allocated_block != NULL);
+}
+
+void
+f_alloc_churn(void)
+{
+  void* blocks[64];
+  while (1) {
+    for (int i = 0; i < 64; i++) {
+      blocks[i] = CSC369_Alloc(1 + (i * 97) % 3000);
+      ck_assert(blocks[i] != NULL);
+      ck_assert_int_eq((long)blocks[i] % 16, 0);
+      *(char*)blocks[i] = (char)i;
+    }
+    for (int i = 0; i < 64; i++) {
+      ck_assert_int_eq(*(char*)blocks[i], (char)i);
+      CSC369_Free(blocks[i]);
+    }
+  }
+}
+
+void
+f_generate_squares(int n)
+{
+  for (long i = 1; i <= n; i++) {
+    CSC369_ThreadSpin(10);
+    CSC369_CoYield((void*)(i * i));
+  }
+}
+
+void
+f_use_stack(int kb)
+{
+  volatile char buffer[1024];
+  buffer[0] = (char)kb;
+  if (buffer[0] > 1) {
+    f_use_stack(kb - 1);
+  }
+}
+
+CSC369_Barrier* test_barrier;
+CSC369_RwLock* test_lock;
+int phase_arrivals[4];
+int serial_threads;
+int readers_inside;
+int writers_inside;
+int finished_threads;
+
+void
+f_barrier_phases(void)
+{
+  for (int phase = 0; phase < 4; phase++) {
+    __sync_fetch_and_add(&phase_arrivals[phase], 1);
+    int const ret = CSC369_BarrierWait(test_barrier);
+    ck_assert_int_ge(ret, 0);
+    if (ret == CSC369_BARRIER_SERIAL_THREAD) {
+      __sync_fetch_and_add(&serial_threads, 1);
+    }
+    // Nobody leaves a phase before everyone has arrived
+    ck_assert_int_eq(phase_arrivals[phase], 8);
+  }
+}
+
+void
+f_read_or_write(long writer)
+{
+  for (int i = 0; i < 50; i++) {
+    if (writer) {
+      ck_assert_int_eq(CSC369_RwLockWrite(test_lock), 0);
+      ck_assert_int_eq(__sync_fetch_and_add(&writers_inside, 1), 0);
+      ck_assert_int_eq(readers_inside, 0);
+      CSC369_ThreadSpin(50);
+      __sync_fetch_and_sub(&writers_inside, 1);
+    } else {
+      ck_assert_int_eq(CSC369_RwLockRead(test_lock), 0);
+      __sync_fetch_and_add(&readers_inside, 1);
+      ck_assert_int_eq(writers_inside, 0);
+      CSC369_ThreadSpin(50);
+      __sync_fetch_and_sub(&readers_inside, 1);
+    }
+    CSC369_RwLockUnlock(test_lock);
+  }
+  __sync_fetch_and_add(&finished_threads, 1);
+}
+
+#define TURN_THREADS 4
+#define TURN_COUNT 100
+
+// Which thread took each turn, in order, logged at its start and at its end
+char turn_log[2 * TURN_THREADS * TURN_COUNT];
+int turn_log_len;
+
+void
+f_log_turns(long id)
+{
+  for (int i = 0; i < TURN_COUNT; i++) {
+    turn_log[__sync_fetch_and_add(&turn_log_len, 1)] = (char)('a' + id);
+    // Not a preemption point, or turns would differ with and without NDEBUG
+    if (!CSC369_InterruptsAreEnabled()) {
+      _exit(2);
+    }
+    turn_log[__sync_fetch_and_add(&turn_log_len, 1)] = (char)('a' + id);
+    CSC369_InterruptsPoll();
+  }
+}
+
 //****************************************************************************
 // Functions to run before/after every test
 //****************************************************************************
@@ -41,6 +157,72 @@ void
 tear_down(void)
 {}
 
+//****************************************************************************
+// Deterministic scheduling
+//****************************************************************************
+
+/*
+ * Runs TURN_THREADS threads of f_log_turns in a new process, with the library
+ * initialized in the given deterministic mode, and copies their turn_log to
+ * log after checking that every turn ran uninterrupted. Returns the length
+ * of the log.
+ */
+int
+run_logged_turns(CSC369_InterruptsMode mode,
+                 unsigned long param,
+                 unsigned long seed,
+                 const char* schedule,
+                 char* log)
+{
+  int fds[2];
+  ck_assert_int_eq(pipe(fds), 0);
+  fflush(NULL);
+  pid_t const pid = fork();
+  ck_assert_int_ge(pid, 0);
+  if (pid == 0) {
+    close(fds[0]);
+    if (CSC369_ThreadInit() != 0) {
+      _exit(2);
+    }
+    CSC369_InterruptsInitDeterministic(mode, param, seed, schedule);
+    Tid tids[TURN_THREADS];
+    for (long i = 0; i < TURN_THREADS; i++) {
+      tids[i] = CSC369_ThreadCreate((void (*)(void*))f_log_turns, (void*)i);
+      if (tids[i] <= 0) {
+        _exit(2);
+      }
+    }
+    // Threads that already exited cannot be joined, so just wait for the rest
+    int exit_value;
+    for (int i = 0; i < TURN_THREADS; i++) {
+      CSC369_ThreadJoin(tids[i], &exit_value);
+    }
+    if (write(fds[1], turn_log, turn_log_len) != turn_log_len) {
+      _exit(2);
+    }
+    // exit, rather than _exit, closes the recorded schedule
+    exit(0);
+  }
+
+  close(fds[1]);
+  int len = 0;
+  ssize_t n;
+  while ((n = read(fds[0], log + len, sizeof(turn_log) - len)) > 0) {
+    len += n;
+  }
+  close(fds[0]);
+  int status;
+  ck_assert_int_eq(waitpid(pid, &status, 0), pid);
+  ck_assert(WIFEXITED(status));
+  ck_assert_int_eq(WEXITSTATUS(status), 0);
+
+  ck_assert_int_eq(len, sizeof(turn_log));
+  for (int i = 0; i < len; i += 2) {
+    ck_assert_int_eq(log[i], log[i + 1]);
+  }
+  return len;
+}
+
 
 START_TEST(test_interupts_stay_enabled)
 {
@@ -105,6 +287,208 @@ START_TEST(test_join_previously_killed)
 }
 END_TEST
 
+START_TEST(test_alloc_reuses_freed_block)
+{
+  ck_assert(CSC369_Alloc(0) == NULL);
+
+  void* const small = CSC369_Alloc(24);
+  ck_assert(small != NULL);
+  CSC369_Free(small);
+  ck_assert(CSC369_Alloc(32) == small);
+
+  void* const large = CSC369_Alloc(3 * CSC369_ARENA_SPAN_SIZE);
+  ck_assert(large != NULL);
+  memset(large, 0xff, 3 * CSC369_ARENA_SPAN_SIZE);
+  CSC369_Free(large);
+}
+END_TEST
+
+START_TEST(test_alloc_released_at_exit)
+{
+  int exit_value;
+  Tid tid = CSC369_ThreadCreate((void (*)(void*))f_alloc_and_exit, (void*)100);
+  ck_assert_int_eq(CSC369_ThreadJoin(tid, &exit_value), tid);
+  void* const first = allocated_block;
+
+  // The exited thread's span went back to the central pool
+  tid = CSC369_ThreadCreate((void (*)(void*))f_alloc_and_exit, (void*)100);
+  ck_assert_int_eq(CSC369_ThreadJoin(tid, &exit_value), tid);
+  ck_assert(allocated_block == first);
+}
+END_TEST
+
+START_TEST(test_alloc_under_preemption)
+{
+  Tid tids[4];
+  for (int i = 0; i < 4; i++) {
+    tids[i] = CSC369_ThreadCreate((void (*)(void*))f_alloc_churn, NULL);
+    ck_assert_int_gt(tids[i], 0);
+  }
+
+  CSC369_ThreadSpin(CSC369_INTERRUPTS_SIGNAL_INTERVAL * 100);
+  ck_assert(CSC369_InterruptsAreEnabled());
+
+  for (int i = 0; i < 4; i++) {
+    ck_assert_int_eq(CSC369_ThreadKill(tids[i]), tids[i]);
+  }
+}
+END_TEST
+
+START_TEST(test_coroutine_generator)
+{
+  CSC369_Coroutine* co =
+    CSC369_CoCreate((void (*)(void*))f_generate_squares, (void*)1000);
+  ck_assert(co != NULL);
+
+  long sum = 0;
+  int resumes = 0;
+  void* value;
+  while (CSC369_CoResume(co, &value) == 1) {
+    sum += (long)value;
+    resumes++;
+    ck_assert(CSC369_InterruptsAreEnabled());
+  }
+  ck_assert_int_eq(resumes, 1000);
+  ck_assert_int_eq(sum, 333833500L);
+
+  // A finished coroutine cannot be resumed
+  ck_assert_int_eq(CSC369_CoResume(co, &value), CSC369_ERROR_THREAD_BAD);
+  ck_assert_int_eq(CSC369_CoDestroy(co), 0);
+}
+END_TEST
+
+START_TEST(test_stack_profile)
+{
+  CSC369_StackProfileEnable(1);
+
+  int exit_value;
+  for (long kb = 4; kb <= 16; kb += 12) {
+    Tid tid = CSC369_ThreadCreate((void (*)(void*))f_use_stack, (void*)kb);
+    ck_assert_int_eq(CSC369_ThreadJoin(tid, &exit_value), tid);
+  }
+  Tid tid = CSC369_ThreadCreate((void (*)(void*))f_no_exit, NULL);
+  ck_assert_int_eq(CSC369_ThreadKill(tid), tid);
+
+  CSC369_StackStats stats[4];
+  ck_assert_int_eq(CSC369_StackProfileGet(stats, 4), 2);
+  ck_assert(stats[0].f == (void (*)(void*))f_use_stack);
+  ck_assert_int_eq(stats[0].threads, 2);
+  ck_assert_int_ge(stats[0].max_used, 16 * 1024);
+  ck_assert_int_lt(stats[0].max_used, CSC369_THREAD_STACK_SIZE);
+  ck_assert_int_lt(stats[0].total_used, 2 * stats[0].max_used);
+
+  // A thread that never ran has not touched its stack
+  ck_assert_int_eq(stats[1].threads, 1);
+  ck_assert_int_lt(stats[1].max_used, 256);
+}
+END_TEST
+
+START_TEST(test_barrier_phases)
+{
+  test_barrier = CSC369_BarrierCreate(8);
+  ck_assert(test_barrier != NULL);
+
+  Tid tids[8];
+  for (int i = 0; i < 8; i++) {
+    tids[i] = CSC369_ThreadCreate((void (*)(void*))f_barrier_phases, NULL);
+    ck_assert_int_gt(tids[i], 0);
+  }
+  // Threads that already exited cannot be joined, so just wait for the rest
+  int exit_value;
+  for (int i = 0; i < 8; i++) {
+    CSC369_ThreadJoin(tids[i], &exit_value);
+  }
+  ck_assert_int_eq(serial_threads, 4);
+  ck_assert_int_eq(CSC369_BarrierDestroy(test_barrier), 0);
+}
+END_TEST
+
+START_TEST(test_rwlock_exclusion)
+{
+  test_lock = CSC369_RwLockCreate();
+  ck_assert(test_lock != NULL);
+
+  Tid tids[10];
+  for (long i = 0; i < 10; i++) {
+    tids[i] = CSC369_ThreadCreate((void (*)(void*))f_read_or_write,
+                                  (void*)(long)(i % 4 == 0));
+    ck_assert_int_gt(tids[i], 0);
+  }
+  int exit_value;
+  for (int i = 0; i < 10; i++) {
+    CSC369_ThreadJoin(tids[i], &exit_value);
+  }
+  ck_assert_int_eq(finished_threads, 10);
+  ck_assert_int_eq(CSC369_RwLockDestroy(test_lock), 0);
+}
+END_TEST
+
+START_TEST(test_random_mode_repeats)
+{
+  char first[sizeof(turn_log)];
+  char second[sizeof(turn_log)];
+  int const len =
+    run_logged_turns(CSC369_INTERRUPTS_RANDOM, 4, 42, NULL, first);
+  ck_assert_int_eq(
+    run_logged_turns(CSC369_INTERRUPTS_RANDOM, 4, 42, NULL, second), len);
+  ck_assert(memcmp(first, second, len) == 0);
+
+  // The threads did interleave, so the comparison means something
+  int switches = 0;
+  for (int i = 2; i < len; i += 2) {
+    switches += first[i] != first[i - 2];
+  }
+  ck_assert_int_gt(switches, TURN_THREADS);
+}
+END_TEST
+
+START_TEST(test_replay_recorded_schedule)
+{
+  // Record in random mode (_i == 0) or in budget mode (_i == 1)
+  CSC369_InterruptsMode const mode =
+    _i == 0 ? CSC369_INTERRUPTS_RANDOM : CSC369_INTERRUPTS_BUDGET;
+  char schedule[] = "/tmp/csc369_scheduleXXXXXX";
+  int const fd = mkstemp(schedule);
+  ck_assert_int_ge(fd, 0);
+  close(fd);
+
+  char recorded[sizeof(turn_log)];
+  char replayed[sizeof(turn_log)];
+  int const len = run_logged_turns(mode, 3, 7, schedule, recorded);
+  ck_assert_int_eq(
+    run_logged_turns(CSC369_INTERRUPTS_REPLAY, 0, 0, schedule, replayed), len);
+  unlink(schedule);
+  ck_assert(memcmp(recorded, replayed, len) == 0);
+}
+END_TEST
+
+// CSC369_SCHED_MODE, CSC369_SCHED_PARAM and CSC369_SCHED_FILE (NULL: unset)
+// that CSC369_InterruptsInit must reject
+char const* const bad_sched_env[][3] = {
+  { "bogus", NULL, NULL },        { "random", "1", NULL },
+  { "random", "abc", NULL },      { "budget", "0", NULL },
+  { "budget", "-3", NULL },       { "budget", "3x", NULL },
+  { "replay", NULL, NULL },
+};
+
+START_TEST(test_bad_sched_env_rejected)
+{
+  char const* const* env = bad_sched_env[_i];
+  char const* const names[3] = { "CSC369_SCHED_MODE",
+                                 "CSC369_SCHED_PARAM",
+                                 "CSC369_SCHED_FILE" };
+  for (int i = 0; i < 3; i++) {
+    if (env[i] != NULL) {
+      ck_assert_int_eq(setenv(names[i], env[i], 1), 0);
+    } else {
+      ck_assert_int_eq(unsetenv(names[i]), 0);
+    }
+  }
+  // Must exit with 1; returning from the test (exit value 0) fails it
+  CSC369_InterruptsInit();
+}
+END_TEST
+
 //****************************************************************************
 // libcheck boilerplate
 //****************************************************************************
@@ -118,9 +502,26 @@ main(void)
   tcase_add_test(test_case, test_join_self);
   tcase_add_test(test_case, test_join_uncreated_tid);
   tcase_add_test(test_case, test_join_previously_killed);
+  tcase_add_test(test_case, test_alloc_reuses_freed_block);
+  tcase_add_test(test_case, test_alloc_released_at_exit);
+  tcase_add_test(test_case, test_alloc_under_preemption);
+  tcase_add_test(test_case, test_coroutine_generator);
+  tcase_add_test(test_case, test_stack_profile);
+  tcase_add_test(test_case, test_barrier_phases);
+  tcase_add_test(test_case, test_rwlock_exclusion);
+
+  TCase* sched_case = tcase_create("Deterministic Scheduling");
+  tcase_add_test(sched_case, test_random_mode_repeats);
+  tcase_add_loop_test(sched_case, test_replay_recorded_schedule, 0, 2);
+  tcase_add_loop_exit_test(sched_case,
+                           test_bad_sched_env_rejected,
+                           1,
+                           0,
+                           sizeof(bad_sched_env) / sizeof(bad_sched_env[0]));
 
   Suite* suite = suite_create("Student Test Suite");
   suite_add_tcase(suite, test_case);
+  suite_add_tcase(suite, sched_case);
 
   SRunner* suite_runner = srunner_create(suite);
   srunner_run_all(suite_runner, CK_VERBOSE);
@@ -18,9 +18,13 @@ import random
 parser = argparse.ArgumentParser(description="Transform reference trace from fastslim to memory simulator input format")
 parser.add_argument("-k", "--keepcode", action="store_true", help="include code pages in trace")
 parser.add_argument("-s", "--simpagesize", type=int, default=16, help="simulated physical page size (smaller than real 4k pagesize)")
+parser.add_argument("--seed", type=int, help="seed for store values, for reproducible traces")
 parser.add_argument("tracefile", nargs='?', default='-')
 args = parser.parse_args()
 
+if args.seed is not None:
+        random.seed(args.seed)
+
 vals = {}
 
 # Process input trace
@@ -0,0 +1,163 @@
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "coremap.h"
+#include "ghost.h"
+#include "pagetable.h"
+#include "pagetable_generic.h"
+#include "sim.h"
+
+// Adaptive Replacement Cache (Megiddo and Modha, FAST '03). Resident pages
+// are on T1 if they were referenced once since they were brought in, or on
+// T2 if they were referenced again. B1 and B2 remember the pages recently
+// evicted from T1 and T2. A miss on a page in B1 means T1 is too small, so
+// the target size p of T1 grows; a miss on a page in B2 shrinks it. A scan
+// only ever reaches T1, so it cannot flush the frequently used pages in T2.
+//
+// T1 and T2 are frame lists (see coremap.h), least recently used at the
+// head.
+
+enum
+{
+  ARC_NONE, // frame was just filled (or is free)
+  ARC_T1,
+  ARC_T2,
+};
+
+enum
+{
+  ARC_B1,
+  ARC_B2,
+};
+
+static _Thread_local struct frame_links arc_lists; // list ARC_T1/T2 - 1
+static _Thread_local size_t arc_t1_len;
+static _Thread_local size_t arc_t2_len;
+static _Thread_local unsigned char* arc_where; // ARC_* for each frame
+static _Thread_local struct ghost_lists arc_ghosts;
+static _Thread_local size_t arc_p; // target size of T1
+
+/*
+ * Removes the least recently used page of T1 or T2 from memory. If
+ * remember is true it becomes the most recent page of B1 or B2.
+ */
+static int
+arc_remove_lru(int from, bool remember)
+{
+  uint32_t frame = frame_list_first(&arc_lists, from - 1);
+  frame_list_del(&arc_lists, frame);
+  if (from == ARC_T1) {
+    arc_t1_len--;
+  } else {
+    arc_t2_len--;
+  }
+  arc_where[frame] = ARC_NONE;
+  if (remember) {
+    int ghost = from == ARC_T1 ? ARC_B1 : ARC_B2;
+    ghost_add(&arc_ghosts, ghost, coremap[frame].pte);
+  }
+  return frame;
+}
+
+/* The REPLACE subroutine of ARC, for a faulting page that is in B2 or not. */
+static int
+arc_replace(bool in_b2)
+{
+  if (arc_t1_len > 0 &&
+      (arc_t1_len > arc_p || (in_b2 && arc_t1_len == arc_p))) {
+    return arc_remove_lru(ARC_T1, true);
+  }
+  return arc_remove_lru(ARC_T2, true);
+}
+
+/* Page to evict is chosen using the ARC algorithm, which also adapts p to
+ * the history of the faulting page (fault_pte).
+ * Returns the page frame number (which is also the index in the coremap)
+ * for the page that is to be evicted.
+ */
+int
+arc_evict(void)
+{
+  size_t b1_len = arc_ghosts.len[ARC_B1];
+  size_t b2_len = arc_ghosts.len[ARC_B2];
+  int ghost = ghost_find(&arc_ghosts, fault_pte);
+
+  if (ghost == ARC_B1) {
+    size_t delta = b2_len > b1_len ? b2_len / b1_len : 1;
+    arc_p = arc_p + delta < memsize ? arc_p + delta : memsize;
+  } else if (ghost == ARC_B2) {
+    size_t delta = b1_len > b2_len ? b1_len / b2_len : 1;
+    arc_p = arc_p > delta ? arc_p - delta : 0;
+  } else if (arc_t1_len + b1_len == memsize) {
+    // L1 = T1 + B1 is full: make room by forgetting its oldest page
+    if (arc_t1_len < memsize) {
+      ghost_remove_lru(&arc_ghosts, ARC_B1);
+    } else {
+      return arc_remove_lru(ARC_T1, false);
+    }
+  } else if (arc_t1_len + arc_t2_len + b1_len + b2_len == 2 * memsize) {
+    ghost_remove_lru(&arc_ghosts, ARC_B2);
+  }
+  return arc_replace(ghost == ARC_B2);
+}
+
+/* This function is called on each access to a page to update any information
+ * needed by the ARC algorithm.
+ * Input: The page table entry for the page that is being accessed.
+ */
+void
+arc_ref(int frame)
+{
+  struct pt_entry_s* pte = coremap[frame].pte;
+  switch (arc_where[frame]) {
+    case ARC_T1:
+      frame_list_del(&arc_lists, frame);
+      arc_t1_len--;
+      break;
+    case ARC_T2:
+      frame_list_del(&arc_lists, frame);
+      arc_t2_len--;
+      break;
+    default:
+      // Faulted in: a page seen for the first time (recently) goes to T1
+      if (ghost_find(&arc_ghosts, pte) == -1) {
+        frame_list_add_tail(&arc_lists, ARC_T1 - 1, frame);
+        arc_t1_len++;
+        arc_where[frame] = ARC_T1;
+        return;
+      }
+      ghost_remove(&arc_ghosts, pte);
+      break;
+  }
+  frame_list_add_tail(&arc_lists, ARC_T2 - 1, frame);
+  arc_t2_len++;
+  arc_where[frame] = ARC_T2;
+}
+
+/* Initialize any data structures needed for this replacement algorithm. */
+void
+arc_init(void)
+{
+  arc_t1_len = 0;
+  arc_t2_len = 0;
+  arc_p = 0;
+  arc_where = calloc(memsize, sizeof(unsigned char));
+  if (!arc_where || frame_links_init(&arc_lists, memsize, 2) != 0) {
+    perror("arc_init");
+    exit(1);
+  }
+  // B1 + B2 holds at most memsize pages, plus the victim of a miss in B1 or
+  // B2 until arc_ref() takes the faulting page off its ghost list
+  ghost_init(&arc_ghosts, memsize + 1);
+}
+
+/* Cleanup any data structures created in arc_init(). */
+void
+arc_cleanup(void)
+{
+  free(arc_where);
+  arc_where = NULL;
+  frame_links_destroy(&arc_lists);
+  ghost_destroy(&arc_ghosts);
+}
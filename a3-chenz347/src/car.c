@@ -0,0 +1,159 @@
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "coremap.h"
+#include "ghost.h"
+#include "pagetable.h"
+#include "pagetable_generic.h"
+#include "sim.h"
+
+// CLOCK with Adaptive Replacement (Bansal and Modha, FAST '04). CAR keeps
+// ARC's lists and adaptive target p, but T1 and T2 are clocks: a hit only
+// sets the page's reference bit, and the hands move referenced pages on
+// (from T1 to T2, or around T2) when looking for a victim. B1 and B2 are
+// LRU lists of recently evicted pages, as in ARC.
+//
+// T1 and T2 are frame lists (see coremap.h), the hand at the head, and the
+// reference bits are a frame bitmap. The PAGE_REF bits of the page table
+// entries follow it, for print_pagetable.
+
+enum
+{
+  CAR_NONE, // frame was just filled (or is free)
+  CAR_T1,
+  CAR_T2,
+};
+
+enum
+{
+  CAR_B1,
+  CAR_B2,
+};
+
+static _Thread_local struct frame_links car_lists; // list CAR_T1/T2 - 1
+static _Thread_local struct frame_bitmap car_ref_bits;
+static _Thread_local size_t car_t1_len;
+static _Thread_local size_t car_t2_len;
+static _Thread_local unsigned char* car_where; // CAR_* for each frame
+static _Thread_local struct ghost_lists car_ghosts;
+static _Thread_local size_t car_p; // target size of T1
+
+/* Page to evict is chosen using the CAR algorithm.
+ * Returns the page frame number (which is also the index in the coremap)
+ * for the page that is to be evicted.
+ */
+int
+car_evict(void)
+{
+  uint32_t frame;
+  while (1) {
+    if (car_t1_len >= (car_p > 1 ? car_p : 1)) {
+      frame = frame_list_first(&car_lists, CAR_T1 - 1);
+      frame_list_del(&car_lists, frame);
+      if (!frame_bitmap_test(&car_ref_bits, frame)) {
+        car_t1_len--;
+        ghost_add(&car_ghosts, CAR_B1, coremap[frame].pte);
+        break;
+      }
+      frame_bitmap_clear(&car_ref_bits, frame);
+      set_referenced(coremap[frame].pte, false);
+      car_t1_len--;
+      car_t2_len++;
+      car_where[frame] = CAR_T2;
+    } else {
+      frame = frame_list_first(&car_lists, CAR_T2 - 1);
+      frame_list_del(&car_lists, frame);
+      if (!frame_bitmap_test(&car_ref_bits, frame)) {
+        car_t2_len--;
+        ghost_add(&car_ghosts, CAR_B2, coremap[frame].pte);
+        break;
+      }
+      frame_bitmap_clear(&car_ref_bits, frame);
+      set_referenced(coremap[frame].pte, false);
+    }
+    frame_list_add_tail(&car_lists, CAR_T2 - 1, frame);
+  }
+  car_where[frame] = CAR_NONE;
+
+  // Keep the history to at most memsize pages when the faulting page is new
+  if (ghost_find(&car_ghosts, fault_pte) == -1) {
+    size_t b1_len = car_ghosts.len[CAR_B1];
+    size_t b2_len = car_ghosts.len[CAR_B2];
+    if (car_t1_len + b1_len == memsize) {
+      ghost_remove_lru(&car_ghosts, CAR_B1);
+    } else if (car_t1_len + car_t2_len + b1_len + b2_len == 2 * memsize) {
+      ghost_remove_lru(&car_ghosts, CAR_B2);
+    }
+  }
+  return frame;
+}
+
+/* This function is called on each access to a page to update any information
+ * needed by the CAR algorithm.
+ * Input: The page table entry for the page that is being accessed.
+ */
+void
+car_ref(int frame)
+{
+  struct pt_entry_s* pte = coremap[frame].pte;
+  if (car_where[frame] != CAR_NONE) {
+    frame_bitmap_set(&car_ref_bits, frame);
+    set_referenced(pte, true);
+    return;
+  }
+
+  // Faulted in: a page seen for the first time (recently) goes to T1, and a
+  // remembered one to T2 after adapting p
+  size_t b1_len = car_ghosts.len[CAR_B1];
+  size_t b2_len = car_ghosts.len[CAR_B2];
+  int ghost = ghost_find(&car_ghosts, pte);
+  if (ghost == -1) {
+    frame_list_add_tail(&car_lists, CAR_T1 - 1, frame);
+    car_t1_len++;
+    car_where[frame] = CAR_T1;
+  } else {
+    if (ghost == CAR_B1) {
+      size_t delta = b2_len > b1_len ? b2_len / b1_len : 1;
+      car_p = car_p + delta < memsize ? car_p + delta : memsize;
+    } else {
+      size_t delta = b1_len > b2_len ? b1_len / b2_len : 1;
+      car_p = car_p > delta ? car_p - delta : 0;
+    }
+    ghost_remove(&car_ghosts, pte);
+    frame_list_add_tail(&car_lists, CAR_T2 - 1, frame);
+    car_t2_len++;
+    car_where[frame] = CAR_T2;
+  }
+  frame_bitmap_clear(&car_ref_bits, frame);
+  set_referenced(pte, false);
+}
+
+/* Initialize any data structures needed for this replacement algorithm. */
+void
+car_init(void)
+{
+  car_t1_len = 0;
+  car_t2_len = 0;
+  car_p = 0;
+  car_where = calloc(memsize, sizeof(unsigned char));
+  if (!car_where || frame_links_init(&car_lists, memsize, 2) != 0 ||
+      frame_bitmap_init(&car_ref_bits, memsize) != 0) {
+    perror("car_init");
+    exit(1);
+  }
+  // The victim joins B1 or B2 before the history is trimmed, so B1 + B2
+  // can briefly reach memsize + 1
+  ghost_init(&car_ghosts, memsize + 1);
+}
+
+/* Cleanup any data structures created in car_init(). */
+void
+car_cleanup(void)
+{
+  free(car_where);
+  car_where = NULL;
+  frame_links_destroy(&car_lists);
+  frame_bitmap_destroy(&car_ref_bits);
+  ghost_destroy(&car_ghosts);
+}
@@ -1,14 +1,35 @@
-#include <assert.h>
-#include <stdlib.h>
 #include <stdio.h>
-#include "sim.h"
-#include "pagetable.h"
+#include <stdlib.h>
+
+#include "coremap.h"
 #include "pagetable_generic.h"
-#include "list.h"
-#define MYPRINTF(a)  //printf a
-static list_head  g_list_head_clock;
-struct list_entry *g_list_hand_entry_clock;
-static int mem_full  = 0;
+#include "sim.h"
+
+// The clock is the frames in frame number order, with one reference bit per
+// frame in a bitmap. Frames are first handed out in that order, so the hand
+// follows them around until memory is full, then starts again at frame 0.
+// Looking for a victim, the hand clears the bits of referenced frames and
+// stops at the first unreferenced one, testing 64 frames per word. The
+// PAGE_REF bits of the page table entries follow the bitmap, for
+// print_pagetable.
+
+static _Thread_local struct frame_bitmap clock_bits;
+static _Thread_local size_t clock_hand;
+static _Thread_local bool clock_full;
+
+/* Clears the reference bits of the frames in mask of word i. */
+static void
+clock_clear(size_t i, uint64_t mask)
+{
+  uint64_t cleared = clock_bits.words[i] & mask;
+  clock_bits.words[i] &= ~mask;
+  while (cleared != 0) {
+    size_t frame = i * FRAME_BITS_PER_WORD + __builtin_ctzll(cleared);
+    set_referenced(coremap[frame].pte, false);
+    cleared &= cleared - 1;
+  }
+}
+
 /* Page to evict is chosen using the CLOCK algorithm.
  * Returns the page frame number (which is also the index in the coremap)
  * for the page that is to be evicted.
@@ -16,21 +37,22 @@ static int mem_full  = 0;
 int
 clock_evict(void)
 {
-  MYPRINTF(("clock_evict mem_full:%d\n",mem_full));
-  struct frame * frame_ptr = NULL;
-  while(1) {
-    frame_ptr = container_of(g_list_hand_entry_clock,struct frame,double_list);
-    MYPRINTF(("clock_evict :%d %d\n",frame_ptr->frame_id,get_referenced(frame_ptr->pte)));
-    g_list_hand_entry_clock = g_list_hand_entry_clock->next;
-    if (g_list_hand_entry_clock == &g_list_head_clock.head)
-         g_list_hand_entry_clock = g_list_hand_entry_clock->next;
-
-    if (get_referenced(frame_ptr->pte) == true) {
-      set_referenced(frame_ptr->pte,false);
-    } else {
-      MYPRINTF(("clock_evict return:%d\n",frame_ptr->frame_id));
-      return frame_ptr->frame_id;
+  uint64_t* words = clock_bits.words;
+  while (1) {
+    size_t i = clock_hand / FRAME_BITS_PER_WORD;
+    uint64_t ahead = frame_bitmap_word_mask(&clock_bits, i) &
+                     (~0ULL << (clock_hand % FRAME_BITS_PER_WORD));
+    uint64_t unreferenced = ~words[i] & ahead;
+    if (unreferenced != 0) {
+      size_t bit = __builtin_ctzll(unreferenced);
+      // The frames the hand passed get their second chance
+      clock_clear(i, ahead & ((1ULL << bit) - 1));
+      size_t frame = i * FRAME_BITS_PER_WORD + bit;
+      clock_hand = frame + 1 < memsize ? frame + 1 : 0;
+      return frame;
     }
+    clock_clear(i, ahead);
+    clock_hand = i + 1 < clock_bits.nwords ? (i + 1) * FRAME_BITS_PER_WORD : 0;
   }
 }
 
@@ -41,60 +63,31 @@ clock_evict(void)
 void
 clock_ref(int frame)
 {
-  MYPRINTF(("clock_ref in  frame:%d mem_full:%d\n",frame,mem_full));
-  set_referenced(coremap[frame].pte,true); /* set to ref */
-  if(mem_full == 0) {
-    /* move to next empty memory */
-     struct frame * frame_ptr = container_of(g_list_hand_entry_clock,struct frame,double_list);
-     if(frame_ptr->frame_id == frame) { /* check */
-      g_list_hand_entry_clock = g_list_hand_entry_clock->next;
-      if(g_list_hand_entry_clock == &g_list_head_clock.head){
-        mem_full = 1;
-        g_list_hand_entry_clock = g_list_hand_entry_clock->next;
-      }
-      }
-  } else {
-    # if 0
-    struct frame * frame_ptr = container_of(g_list_hand_entry_clock,struct frame,double_list);
-    if(frame_ptr->frame_id == frame) { /* check */
-      while(1) {
-        frame_ptr = container_of(g_list_hand_entry_clock,struct frame,double_list);
-        MYPRINTF(("memid %d ref:%d\n",frame_ptr->frame_id,get_referenced(frame_ptr->pte)));
-        if (get_referenced(frame_ptr->pte) == true) {
-          set_referenced(frame_ptr->pte,false);
-          g_list_hand_entry_clock = g_list_hand_entry_clock->next;
-          if (g_list_hand_entry_clock == &g_list_head_clock.head)
-            g_list_hand_entry_clock = g_list_hand_entry_clock->next;
-        } else {
-          break;
-        }
-      }
+  frame_bitmap_set(&clock_bits, frame);
+  set_referenced(coremap[frame].pte, true);
+  if (!clock_full && (size_t)frame == clock_hand) {
+    if (++clock_hand == memsize) {
+      clock_hand = 0;
+      clock_full = true;
     }
-    # endif
   }
-  MYPRINTF(("clock_ref out frame:%d mem_full:%d\n",frame,mem_full));
 }
 
 /* Initialize any data structures needed for this replacement algorithm. */
 void
 clock_init(void)
 {
-  MYPRINTF(("clock_init in,memsize:%d\n",(unsigned int )memsize));
-  /* list initialization */  
-  list_init(&g_list_head_clock);
-  for (size_t i = 0; i < memsize; i++) {
-    coremap[i].in_use = false;
-    coremap[i].pte = NULL;
-    coremap[i].frame_id = i;
-    list_entry_init(&coremap[i].double_list);
-    list_add_tail(&g_list_head_clock,&coremap[i].double_list);
+  if (frame_bitmap_init(&clock_bits, memsize) != 0) {
+    perror("clock_init");
+    exit(1);
   }
-  g_list_hand_entry_clock = g_list_head_clock.head.next; /* skip head */
-  mem_full = 0;
-  MYPRINTF(("clock_init out\n"));
+  clock_hand = 0;
+  clock_full = false;
 }
 
 /* Cleanup any data structures created in clock_init(). */
 void
 clock_cleanup(void)
-{}
+{
+  frame_bitmap_destroy(&clock_bits);
+}
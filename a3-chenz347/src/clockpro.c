@@ -0,0 +1,294 @@
+#include <assert.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "list.h"
+#include "pagetable.h"
+#include "pagetable_generic.h"
+#include "sim.h"
+#include "vpnmap.h"
+
+// CLOCK-Pro (Jiang, Chen and Zhang, USENIX '05), a clock approximation of
+// LIRS. Resident pages are hot or cold, and a cold page spends a test
+// period on the clock after it is brought in; if it is evicted during the
+// test period it stays on the clock as a non-resident cold page. A cold
+// page referenced during its test period has a short reuse distance and
+// becomes hot. Three hands sweep the clock:
+//
+// - HAND_cold looks for a resident cold page with its reference bit clear
+//   to evict; the only hand that frees a frame.
+// - HAND_hot turns the next unreferenced hot page cold whenever there are
+//   more hot pages than memsize - mc, ending test periods on its way.
+// - HAND_test ends the test period of the next cold page it passes, and
+//   removes non-resident ones, whenever more than memsize are on the clock.
+//
+// The target mc for cold pages adapts: it grows when a non-resident cold
+// page is referenced during its test period, and shrinks when one reaches
+// the end of its test period. New pages go right behind HAND_hot, which is
+// the list head of the paper.
+
+enum
+{
+  CP_HOT,
+  CP_COLD,
+};
+
+struct clockpro_page
+{
+  list_entry link; // position on the clock, or on the free list
+  struct pt_entry_s* pte;
+  int frame; // -1 for a non-resident cold page
+  unsigned char status;
+  bool test; // cold page in its test period
+  bool ref;
+};
+
+static _Thread_local struct clockpro_page* cp_pool;
+static _Thread_local list_head cp_free;
+static _Thread_local struct clockpro_page** cp_frame_page; // NULL if evicted
+static _Thread_local struct vpnmap cp_nonresident;        // pte -> pool index
+static _Thread_local list_head cp_clock;
+static _Thread_local list_entry* cp_hand_hot;
+static _Thread_local list_entry* cp_hand_cold;
+static _Thread_local list_entry* cp_hand_test;
+static _Thread_local size_t cp_hot_len;
+static _Thread_local size_t cp_cold_len;
+static _Thread_local size_t cp_test_len; // non-resident cold pages
+static _Thread_local size_t cp_cold_target; // mc
+
+static struct clockpro_page*
+cp_page(list_entry* e)
+{
+  return container_of(e, struct clockpro_page, link);
+}
+
+/* Returns the entry after e on the clock, skipping the list head. */
+static list_entry*
+cp_next(list_entry* e)
+{
+  e = e->next;
+  return e == &cp_clock.head ? e->next : e;
+}
+
+/* Adds a page to the clock right behind HAND_hot. */
+static void
+cp_insert(struct clockpro_page* p)
+{
+  if (cp_hand_hot == NULL) {
+    list_add_tail(&cp_clock, &p->link);
+    cp_hand_hot = cp_hand_cold = cp_hand_test = &p->link;
+    return;
+  }
+  __list_insert(&p->link, cp_hand_hot->prev, cp_hand_hot);
+}
+
+/* Takes a page off the clock, moving any hand on it to the next page. */
+static void
+cp_remove(struct clockpro_page* p)
+{
+  list_entry* next = cp_next(&p->link);
+  if (next == &p->link) {
+    next = NULL;
+  }
+  if (cp_hand_hot == &p->link) {
+    cp_hand_hot = next;
+  }
+  if (cp_hand_cold == &p->link) {
+    cp_hand_cold = next;
+  }
+  if (cp_hand_test == &p->link) {
+    cp_hand_test = next;
+  }
+  list_del(&p->link);
+}
+
+/* Removes a non-resident cold page at the end of its test period. */
+static void
+cp_remove_test(struct clockpro_page* p)
+{
+  cp_remove(p);
+  vpnmap_remove(&cp_nonresident, (uintptr_t)p->pte);
+  cp_test_len--;
+  if (cp_cold_target > 1) {
+    cp_cold_target--;
+  }
+  list_add_tail(&cp_free, &p->link);
+}
+
+/* Runs HAND_hot until it turns one hot page cold. */
+static void
+cp_run_hand_hot(void)
+{
+  while (1) {
+    struct clockpro_page* p = cp_page(cp_hand_hot);
+    if (p->status == CP_COLD && p->frame == -1) {
+      cp_remove_test(p);
+      continue;
+    }
+    cp_hand_hot = cp_next(cp_hand_hot);
+    if (p->status == CP_COLD) {
+      p->test = false;
+    } else if (p->ref) {
+      p->ref = false;
+    } else {
+      p->status = CP_COLD;
+      cp_hot_len--;
+      cp_cold_len++;
+      return;
+    }
+  }
+}
+
+/* Runs HAND_test until it removes one non-resident cold page. */
+static void
+cp_run_hand_test(void)
+{
+  while (1) {
+    struct clockpro_page* p = cp_page(cp_hand_test);
+    if (p->status == CP_COLD && p->frame == -1) {
+      cp_remove_test(p);
+      return;
+    }
+    if (p->status == CP_COLD) {
+      p->test = false;
+    }
+    cp_hand_test = cp_next(cp_hand_test);
+  }
+}
+
+static void
+cp_balance_hot(void)
+{
+  while (cp_hot_len > memsize - cp_cold_target) {
+    cp_run_hand_hot();
+  }
+}
+
+/* Page to evict is chosen using the CLOCK-Pro algorithm (HAND_cold).
+ * Returns the page frame number (which is also the index in the coremap)
+ * for the page that is to be evicted.
+ */
+int
+clockpro_evict(void)
+{
+  while (1) {
+    struct clockpro_page* p = cp_page(cp_hand_cold);
+    cp_hand_cold = cp_next(cp_hand_cold);
+    if (p->status != CP_COLD || p->frame == -1) {
+      continue;
+    }
+
+    if (p->ref) {
+      // Referenced during its test period: hot. Otherwise start a new one.
+      p->ref = false;
+      if (p->test) {
+        p->status = CP_HOT;
+        p->test = false;
+        cp_cold_len--;
+        cp_hot_len++;
+        cp_balance_hot();
+      } else {
+        p->test = true;
+      }
+      continue;
+    }
+
+    int frame = p->frame;
+    cp_frame_page[frame] = NULL;
+    cp_cold_len--;
+    if (!p->test) {
+      cp_remove(p);
+      list_add_tail(&cp_free, &p->link);
+      return frame;
+    }
+
+    // Keep it on the clock for the rest of its test period
+    p->frame = -1;
+    *vpnmap_lookup(&cp_nonresident, (uintptr_t)p->pte, NULL) = p - cp_pool;
+    if (++cp_test_len > memsize) {
+      cp_run_hand_test();
+    }
+    return frame;
+  }
+}
+
+/* This function is called on each access to a page to update any information
+ * needed by the CLOCK-Pro algorithm.
+ * Input: The page table entry for the page that is being accessed.
+ */
+void
+clockpro_ref(int frame)
+{
+  struct clockpro_page* p = cp_frame_page[frame];
+  if (p != NULL) {
+    p->ref = true;
+    return;
+  }
+
+  // Faulted in
+  struct pt_entry_s* pte = coremap[frame].pte;
+  uint64_t* pos = vpnmap_find(&cp_nonresident, (uintptr_t)pte);
+  if (pos != NULL) {
+    // Referenced during its test period while not resident: becomes hot
+    p = &cp_pool[*pos];
+    vpnmap_remove(&cp_nonresident, (uintptr_t)pte);
+    cp_remove(p);
+    cp_test_len--;
+    if (cp_cold_target < memsize) {
+      cp_cold_target++;
+    }
+    p->status = CP_HOT;
+    p->test = false;
+    cp_hot_len++;
+  } else {
+    assert(cp_free.head.next != &cp_free.head);
+    p = cp_page(cp_free.head.next);
+    list_del(&p->link);
+    p->pte = pte;
+    p->status = CP_COLD;
+    p->test = true;
+    cp_cold_len++;
+  }
+  p->frame = frame;
+  p->ref = false;
+  cp_frame_page[frame] = p;
+  cp_insert(p);
+  cp_balance_hot();
+}
+
+/* Initialize any data structures needed for this replacement algorithm. */
+void
+clockpro_init(void)
+{
+  // memsize resident pages and up to memsize non-resident ones
+  size_t capacity = 2 * memsize;
+  cp_pool = malloc(capacity * sizeof(struct clockpro_page));
+  cp_frame_page = calloc(memsize, sizeof(struct clockpro_page*));
+  if (!cp_pool || !cp_frame_page) {
+    perror("clockpro_init");
+    exit(1);
+  }
+  list_init(&cp_free);
+  for (size_t i = 0; i < capacity; i++) {
+    list_add_tail(&cp_free, &cp_pool[i].link);
+  }
+  vpnmap_init(&cp_nonresident);
+  list_init(&cp_clock);
+  cp_hand_hot = cp_hand_cold = cp_hand_test = NULL;
+  cp_hot_len = 0;
+  cp_cold_len = 0;
+  cp_test_len = 0;
+  cp_cold_target = memsize;
+}
+
+/* Cleanup any data structures created in clockpro_init(). */
+void
+clockpro_cleanup(void)
+{
+  free(cp_pool);
+  free(cp_frame_page);
+  cp_pool = NULL;
+  cp_frame_page = NULL;
+  vpnmap_destroy(&cp_nonresident);
+}
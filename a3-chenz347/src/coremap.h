@@ -0,0 +1,155 @@
+#ifndef CSC369_COREMAP_H
+#define CSC369_COREMAP_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+// Per-policy frame metadata, kept in dense arrays indexed by frame number
+// instead of in struct frame, so that a policy walking its frames only
+// touches the bytes it uses. A policy allocates what it needs in its init
+// and frees it in its cleanup.
+
+//---------------------------------------------------------------------
+// Frame lists: circular doubly-linked lists of frames through 32-bit frame
+// numbers. One frame_links holds the links of every frame and the heads of
+// nlists lists, which share them: a frame is on at most one list at a time.
+// The head of list i sits at index nframes + i.
+
+#define FRAME_NONE UINT32_MAX // link of a frame that is on no list
+
+struct frame_links
+{
+  uint32_t* next;
+  uint32_t* prev;
+  uint32_t nframes;
+};
+
+/*
+ * Allocates nlists empty lists of nframes frames. Returns 0, or -1 if out
+ * of memory.
+ */
+static inline int
+frame_links_init(struct frame_links* l, size_t nframes, size_t nlists)
+{
+  l->next = malloc((nframes + nlists) * sizeof(uint32_t));
+  l->prev = malloc((nframes + nlists) * sizeof(uint32_t));
+  if (!l->next || !l->prev) {
+    return -1;
+  }
+  l->nframes = nframes;
+  for (size_t i = 0; i < nframes; i++) {
+    l->next[i] = FRAME_NONE;
+    l->prev[i] = FRAME_NONE;
+  }
+  for (size_t i = nframes; i < nframes + nlists; i++) {
+    l->next[i] = i;
+    l->prev[i] = i;
+  }
+  return 0;
+}
+
+static inline void
+frame_links_destroy(struct frame_links* l)
+{
+  free(l->next);
+  free(l->prev);
+  l->next = NULL;
+  l->prev = NULL;
+}
+
+static inline bool
+frame_list_contains(const struct frame_links* l, uint32_t frame)
+{
+  return l->next[frame] != FRAME_NONE;
+}
+
+/* Returns the first frame of the list, or FRAME_NONE if it is empty. */
+static inline uint32_t
+frame_list_first(const struct frame_links* l, unsigned int list)
+{
+  uint32_t first = l->next[l->nframes + list];
+  return first == l->nframes + list ? FRAME_NONE : first;
+}
+
+static inline void
+frame_list_add_tail(struct frame_links* l, unsigned int list, uint32_t frame)
+{
+  uint32_t head = l->nframes + list;
+  uint32_t last = l->prev[head];
+  l->next[frame] = head;
+  l->prev[frame] = last;
+  l->next[last] = frame;
+  l->prev[head] = frame;
+}
+
+static inline void
+frame_list_del(struct frame_links* l, uint32_t frame)
+{
+  l->next[l->prev[frame]] = l->next[frame];
+  l->prev[l->next[frame]] = l->prev[frame];
+  l->next[frame] = FRAME_NONE;
+  l->prev[frame] = FRAME_NONE;
+}
+
+//---------------------------------------------------------------------
+// Frame bitmaps: one bit per frame, 64 frames to a word, so that a scan for
+// a clear bit (e.g., an unreferenced frame) tests a whole word at a time.
+
+#define FRAME_BITS_PER_WORD 64
+
+struct frame_bitmap
+{
+  uint64_t* words;
+  size_t nframes;
+  size_t nwords;
+};
+
+/* Allocates nframes clear bits. Returns 0, or -1 if out of memory. */
+static inline int
+frame_bitmap_init(struct frame_bitmap* b, size_t nframes)
+{
+  b->nframes = nframes;
+  b->nwords = (nframes + FRAME_BITS_PER_WORD - 1) / FRAME_BITS_PER_WORD;
+  b->words = calloc(b->nwords, sizeof(uint64_t));
+  return b->words ? 0 : -1;
+}
+
+static inline void
+frame_bitmap_destroy(struct frame_bitmap* b)
+{
+  free(b->words);
+  b->words = NULL;
+}
+
+static inline bool
+frame_bitmap_test(const struct frame_bitmap* b, size_t frame)
+{
+  return (b->words[frame / FRAME_BITS_PER_WORD] >>
+          (frame % FRAME_BITS_PER_WORD)) & 1;
+}
+
+static inline void
+frame_bitmap_set(struct frame_bitmap* b, size_t frame)
+{
+  b->words[frame / FRAME_BITS_PER_WORD] |=
+    1ULL << (frame % FRAME_BITS_PER_WORD);
+}
+
+static inline void
+frame_bitmap_clear(struct frame_bitmap* b, size_t frame)
+{
+  b->words[frame / FRAME_BITS_PER_WORD] &=
+    ~(1ULL << (frame % FRAME_BITS_PER_WORD));
+}
+
+/* Bits of word i that stand for frames, all of them but in the last word. */
+static inline uint64_t
+frame_bitmap_word_mask(const struct frame_bitmap* b, size_t i)
+{
+  size_t used = b->nframes - i * FRAME_BITS_PER_WORD;
+  return used >= FRAME_BITS_PER_WORD ? ~0ULL : (1ULL << used) - 1;
+}
+
+#endif /* CSC369_COREMAP_H */
@@ -0,0 +1,364 @@
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "engine.h"
+#include "pagetable_generic.h"
+#include "sim.h"
+#include "swap.h"
+#include "timer.h"
+
+// Define per-instance variables declared in sim.h and pagetable_generic.h
+_Thread_local size_t memsize = 0;
+_Thread_local unsigned char* physmem = NULL;
+_Thread_local struct frame* coremap = NULL;
+_Thread_local int instance_pid = -1;
+
+/* Each eviction algorithm is represented by a structure with its name
+ * and three functions.
+ */
+struct functions
+{
+  const char* name;      // String name of eviction algorithm
+  void (*init)(void);    // Initialize any data needed by alg
+  void (*cleanup)(void); // Cleanup any data initialized in init()
+  void (*ref)(int);      // Called on each reference
+  int (*evict)(void);    // Called to choose victim for eviction
+};
+
+/* The algs array gives us a mapping between the name of an eviction
+ * algorithm as given in a command line argument, and the function to
+ * call to select the victim page.
+ */
+static struct functions algs[] = {
+  { "rand", rand_init, rand_cleanup, rand_ref, rand_evict },
+  { "rr", rr_init, rr_cleanup, rr_ref, rr_evict },
+  { "clock", clock_init, clock_cleanup, clock_ref, clock_evict },
+  { "lru", lru_init, lru_cleanup, lru_ref, lru_evict },
+  { "opt", opt_init, opt_cleanup, opt_ref, opt_evict },
+  { "arc", arc_init, arc_cleanup, arc_ref, arc_evict },
+  { "car", car_init, car_cleanup, car_ref, car_evict },
+  { "lirs", lirs_init, lirs_cleanup, lirs_ref, lirs_evict },
+  { "clockpro", clockpro_init, clockpro_cleanup, clockpro_ref,
+    clockpro_evict },
+};
+static size_t num_algs = sizeof(algs) / sizeof(algs[0]);
+
+static _Thread_local void (*init_func)() = NULL;
+static _Thread_local void (*cleanup_func)() = NULL;
+
+_Thread_local void (*ref_func)(int) = NULL;
+_Thread_local int (*evict_func)() = NULL;
+
+static _Thread_local double instance_starttime;
+
+/* Returns the index of the named algorithm in algs, or -1 if unknown. */
+int
+sim_find_alg(const char* name)
+{
+  for (size_t i = 0; i < num_algs; ++i) {
+    if (strcmp(algs[i].name, name) == 0) {
+      return i;
+    }
+  }
+  return -1;
+}
+
+const char*
+sim_alg_name(int alg)
+{
+  return algs[alg].name;
+}
+
+size_t
+sim_num_algs(void)
+{
+  return num_algs;
+}
+
+/*
+ * Parses a list of algorithms: a single name, a comma-separated list of
+ * names, or "all". Stores their indices in algs and returns how many there
+ * are, or 0 if a name is not recognized.
+ */
+size_t
+sim_parse_algs(char* arg, int* alg_list, size_t max_algs)
+{
+  size_t n = 0;
+  if (strcmp(arg, "all") == 0) {
+    for (size_t i = 0; i < num_algs && n < max_algs; ++i) {
+      alg_list[n++] = i;
+    }
+    return n;
+  }
+
+  char* saveptr = NULL;
+  for (char* name = strtok_r(arg, ",", &saveptr); name != NULL;
+       name = strtok_r(NULL, ",", &saveptr)) {
+    int alg = sim_find_alg(name);
+    if (alg == -1 || n == max_algs) {
+      fprintf(stderr, "Error: invalid replacement algorithm - %s\n", name);
+      return 0;
+    }
+    alg_list[n++] = alg;
+  }
+  return n;
+}
+
+/*
+ * Allocates the (simulated) physical memory, coremap and swap file for an
+ * instance of algorithm alg on the calling thread.
+ */
+void
+sim_instance_init(int alg, size_t mem, size_t swapsize)
+{
+  // Initialize main data structures for simulation.
+  // This happens before calling the replacement algorithm init function
+  // so that the init_func can refer to the coremap if needed.
+  memsize = mem;
+  coremap = malloc(memsize * sizeof(struct frame));
+  physmem = malloc(memsize * SIMPAGESIZE);
+  if (!coremap || !physmem) {
+    perror("sim_instance_init");
+    exit(1);
+  }
+  swap_init(swapsize);
+
+  init_func = algs[alg].init;
+  cleanup_func = algs[alg].cleanup;
+  ref_func = algs[alg].ref;
+  evict_func = algs[alg].evict;
+}
+
+/*
+ * Calls the pagetable and replacement algorithm's init_func before
+ * replaying the trace.
+ */
+void
+sim_instance_start(void)
+{
+  hit_count = 0;
+  miss_count = 0;
+  ref_count = 0;
+  evict_clean_count = 0;
+  evict_dirty_count = 0;
+  tlb_hit_count = 0;
+  walk_count = 0;
+  memset(&hugepage_stats, 0, sizeof(hugepage_stats));
+  memset(&readahead_stats, 0, sizeof(readahead_stats));
+
+  instance_starttime = get_thread_time();
+  init_pagetable();
+  init_func();
+  timeseries_init();
+}
+
+/* An actual memory access based on the vaddr from the trace file.
+ *
+ * The find_physpage() function is called to translate the virtual address
+ * to a (simulated) physical address -- that is, a pointer to the right
+ * location in physmem array. The find_physpage() function is responsible for
+ * everything to do with memory management - including translation using the
+ * pagetable, allocating a frame of (simulated) physical memory (if needed),
+ * evicting an existing page from the frame (if needed) and reading the page
+ * in from swap (if needed).
+ *
+ * We then check that the memory has the expected content (just a copy of the
+ * virtual address) and, in case of a write reference, increment the version
+ * counter.
+ */
+void
+sim_access(const struct trace_ref* ref, size_t linenum)
+{
+  unsigned char* pgptr;
+  unsigned char* memptr;
+  unsigned offset = ref->vaddr % PAGE_SIZE;
+
+  pgptr = find_physpage(ref->pid, ref->vaddr, ref->type);
+  memptr = pgptr + offset;
+
+  if ((ref->type == 'S') || (ref->type == 'M')) {
+    // write access to page, update value in simulated memory
+    *memptr = ref->val;
+  } else if ((ref->type == 'L' || ref->type == 'I')) {
+    if (*memptr != ref->val) {
+      printf("ERROR at trace line %zu: vaddr has %hhu but should have %hhu\n",
+             linenum,
+             *memptr,
+             ref->val);
+    }
+  }
+}
+
+/*
+ * Replays count references held in memory in the binary trace encoding.
+ * Line numbers in error messages are record numbers.
+ */
+void
+sim_replay_records(const uint64_t* records, size_t count)
+{
+  struct trace_ref ref;
+  unsigned short pid = 0;
+  for (size_t i = 0; i < count; i++) {
+    if (trace_decode(records[i], &pid, &ref)) {
+      sim_access(&ref, i + 1);
+    }
+  }
+}
+
+/*
+ * Collects the instance's counters into result and releases everything
+ * allocated by sim_instance_init and sim_instance_start.
+ */
+void
+sim_instance_finish(struct sim_result* result)
+{
+  result->time = get_thread_time() - instance_starttime;
+  result->hit_count = hit_count;
+  result->miss_count = miss_count;
+  result->ref_count = ref_count;
+  result->evict_clean_count = evict_clean_count;
+  result->evict_dirty_count = evict_dirty_count;
+  result->tlb_hit_count = tlb_hit_count;
+  result->walk_count = walk_count;
+  result->huge = hugepage_stats;
+  result->readahead = readahead_stats;
+  timeseries_finish(&result->series);
+  // Hand the per-process counters over before free_pagetable releases them
+  result->procs = proc_stats;
+  result->num_procs = num_procs;
+  proc_stats = NULL;
+  num_procs = 0;
+
+  cleanup_func();
+
+  // Cleanup data structures and remove temporary swapfile
+  free(coremap);
+  free(physmem);
+  coremap = NULL;
+  physmem = NULL;
+  swap_destroy();
+  free_pagetable();
+}
+
+//---------------------------------------------------------------------
+// Running several instances over one pass of a trace.
+//
+// The main thread decodes the trace into one of two chunk buffers while the
+// workers replay the other. A single barrier per chunk hands a full buffer
+// to the workers and guarantees they are done with the buffer the main
+// thread is about to refill. An empty chunk marks the end of the trace.
+
+#define SIM_CHUNK_REFS 65536
+
+struct sim_chunk
+{
+  struct trace_ref* refs;
+  size_t* linenums;
+  size_t len;
+};
+
+struct sim_run
+{
+  char* tracefile;
+  struct sim_chunk chunks[2];
+  pthread_barrier_t barrier;
+};
+
+struct sim_worker_arg
+{
+  struct sim_run* run;
+  struct sim_job* job;
+};
+
+static void*
+sim_worker(void* arg)
+{
+  struct sim_run* run = ((struct sim_worker_arg*)arg)->run;
+  struct sim_job* job = ((struct sim_worker_arg*)arg)->job;
+
+  tracefile = run->tracefile;
+  instance_pid = job->pid;
+  sim_instance_init(job->alg, job->memsize, job->swapsize);
+  sim_instance_start();
+  for (int i = 0;; i ^= 1) {
+    pthread_barrier_wait(&run->barrier);
+    const struct sim_chunk* chunk = &run->chunks[i];
+    if (chunk->len == 0) {
+      break;
+    }
+    for (size_t k = 0; k < chunk->len; k++) {
+      if (job->pid < 0 || chunk->refs[k].pid == job->pid) {
+        sim_access(&chunk->refs[k], chunk->linenums[k]);
+      }
+    }
+  }
+  sim_instance_finish(&job->result);
+  return NULL;
+}
+
+/*
+ * Replays trace t once, feeding every reference to each of the njobs
+ * instances, which run on their own threads. An instance whose job has a
+ * pid only sees the references of that process. Results are stored in jobs;
+ * returns the number of references in the trace.
+ */
+size_t
+sim_run_jobs(trace_t* t, struct sim_job* jobs, size_t njobs)
+{
+  size_t total = 0;
+  struct sim_run run;
+  run.tracefile = tracefile;
+  for (int i = 0; i < 2; i++) {
+    run.chunks[i].refs = malloc(SIM_CHUNK_REFS * sizeof(struct trace_ref));
+    run.chunks[i].linenums = malloc(SIM_CHUNK_REFS * sizeof(size_t));
+    if (!run.chunks[i].refs || !run.chunks[i].linenums) {
+      perror("sim_run_jobs");
+      exit(1);
+    }
+  }
+  pthread_barrier_init(&run.barrier, NULL, njobs + 1);
+
+  pthread_t* threads = malloc(njobs * sizeof(pthread_t));
+  struct sim_worker_arg* args = malloc(njobs * sizeof(struct sim_worker_arg));
+  if (!threads || !args) {
+    perror("sim_run_jobs");
+    exit(1);
+  }
+  for (size_t j = 0; j < njobs; j++) {
+    args[j].run = &run;
+    args[j].job = &jobs[j];
+    int err = pthread_create(&threads[j], NULL, sim_worker, &args[j]);
+    if (err != 0) {
+      fprintf(stderr, "sim_run_jobs: pthread_create: %s\n", strerror(err));
+      exit(1);
+    }
+  }
+
+  for (int i = 0;; i ^= 1) {
+    struct sim_chunk* chunk = &run.chunks[i];
+    chunk->len = 0;
+    while (chunk->len < SIM_CHUNK_REFS &&
+           trace_next(t, &chunk->refs[chunk->len])) {
+      chunk->linenums[chunk->len++] = t->linenum;
+    }
+    total += chunk->len;
+    pthread_barrier_wait(&run.barrier);
+    if (chunk->len == 0) {
+      break;
+    }
+  }
+
+  for (size_t j = 0; j < njobs; j++) {
+    pthread_join(threads[j], NULL);
+  }
+  pthread_barrier_destroy(&run.barrier);
+  free(threads);
+  free(args);
+  for (int i = 0; i < 2; i++) {
+    free(run.chunks[i].refs);
+    free(run.chunks[i].linenums);
+  }
+  return total;
+}
@@ -0,0 +1,83 @@
+#ifndef CSC369_ENGINE_H
+#define CSC369_ENGINE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "sim.h"
+#include "timeseries.h"
+#include "trace.h"
+
+// A simulator instance is one replacement algorithm with its own memory,
+// page table, swap file and counters. Instance state is thread-local, so
+// one thread runs at most one instance at a time, and several instances
+// can replay the same trace concurrently on different threads.
+//
+// Options (the swap backend, TLB, huge pages, readahead and time series) are
+// configured once from the command line, before any instance starts, and
+// are read-only afterwards. Each instance then keeps its own state for them,
+// from its own TLB to its own samples.
+
+// Counters collected from a finished instance
+struct sim_result
+{
+  size_t hit_count;
+  size_t miss_count;
+  size_t ref_count;
+  size_t evict_clean_count;
+  size_t evict_dirty_count;
+  size_t tlb_hit_count; // 0 unless the TLB is enabled
+  size_t walk_count;    // page table walks (every reference without a TLB)
+  double time; // CPU time spent replaying the trace, in seconds
+  struct hugepage_stats huge;
+  struct readahead_stats readahead;
+  struct timeseries series; // samples, if timeseries_enabled
+  struct proc_stats* procs; // indexed by pid, freed by the caller
+  size_t num_procs;
+};
+
+// One instance to run over a shared trace
+struct sim_job
+{
+  int alg; // index returned by sim_find_alg()
+  size_t memsize;
+  size_t swapsize;
+  int pid; // replay only this process's references, or -1 for all of them
+  struct sim_result result;
+};
+
+int
+sim_find_alg(const char* name);
+const char*
+sim_alg_name(int alg);
+size_t
+sim_num_algs(void);
+size_t
+sim_parse_algs(char* arg, int* alg_list, size_t max_algs);
+
+void
+sim_instance_init(int alg, size_t memsize, size_t swapsize);
+void
+sim_instance_start(void);
+void
+sim_access(const struct trace_ref* ref, size_t linenum);
+void
+sim_replay_records(const uint64_t* records, size_t count);
+void
+sim_instance_finish(struct sim_result* result);
+
+size_t
+sim_run_jobs(trace_t* t, struct sim_job* jobs, size_t njobs);
+
+// Next uses of the references of a trace for opt (see opt.c). Instances
+// started on a thread while opt_shared_trace is set use it instead of
+// reading the trace again.
+struct opt_trace;
+extern _Thread_local struct opt_trace* opt_shared_trace;
+
+struct opt_trace*
+opt_trace_from_records(const uint64_t* records, size_t count);
+void
+opt_trace_free(struct opt_trace* ot);
+
+#endif /* CSC369_ENGINE_H */
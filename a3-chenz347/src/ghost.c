@@ -0,0 +1,85 @@
+#include <assert.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "ghost.h"
+
+/* Sets up empty ghost lists that can remember up to capacity pages. */
+void
+ghost_init(struct ghost_lists* g, size_t capacity)
+{
+  g->pool = malloc(capacity * sizeof(struct ghost));
+  if (!g->pool) {
+    perror("ghost_init");
+    exit(1);
+  }
+  list_init(&g->free);
+  for (size_t i = 0; i < capacity; i++) {
+    list_add_tail(&g->free, &g->pool[i].link);
+  }
+  vpnmap_init(&g->index);
+  for (int l = 0; l < GHOST_MAX_LISTS; l++) {
+    list_init(&g->lists[l]);
+    g->len[l] = 0;
+  }
+}
+
+void
+ghost_destroy(struct ghost_lists* g)
+{
+  free(g->pool);
+  g->pool = NULL;
+  vpnmap_destroy(&g->index);
+}
+
+/* Returns the list that remembers the page of pte, or -1 if none does. */
+int
+ghost_find(struct ghost_lists* g, struct pt_entry_s* pte)
+{
+  uint64_t* pos = vpnmap_find(&g->index, (uintptr_t)pte);
+  return pos != NULL ? g->pool[*pos].list : -1;
+}
+
+/* Remembers the page of pte as the most recent ghost on list. */
+void
+ghost_add(struct ghost_lists* g, int list, struct pt_entry_s* pte)
+{
+  assert(g->free.head.next != &g->free.head);
+  struct ghost* ghost = container_of(g->free.head.next, struct ghost, link);
+  list_del(&ghost->link);
+  ghost->pte = pte;
+  ghost->list = list;
+  list_add_tail(&g->lists[list], &ghost->link);
+  g->len[list]++;
+
+  bool inserted;
+  *vpnmap_lookup(&g->index, (uintptr_t)pte, &inserted) = ghost - g->pool;
+  assert(inserted);
+}
+
+static void
+ghost_release(struct ghost_lists* g, struct ghost* ghost)
+{
+  vpnmap_remove(&g->index, (uintptr_t)ghost->pte);
+  list_del(&ghost->link);
+  g->len[ghost->list]--;
+  list_add_tail(&g->free, &ghost->link);
+}
+
+/* Forgets the page of pte, which must be remembered. */
+void
+ghost_remove(struct ghost_lists* g, struct pt_entry_s* pte)
+{
+  uint64_t* pos = vpnmap_find(&g->index, (uintptr_t)pte);
+  assert(pos != NULL);
+  ghost_release(g, &g->pool[*pos]);
+}
+
+/* Forgets the least recent ghost on list, which must not be empty. */
+void
+ghost_remove_lru(struct ghost_lists* g, int list)
+{
+  assert(g->len[list] > 0);
+  ghost_release(g, container_of(g->lists[list].head.next, struct ghost, link));
+}
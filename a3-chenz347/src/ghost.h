@@ -0,0 +1,47 @@
+#ifndef CSC369_GHOST_H
+#define CSC369_GHOST_H
+
+#include <stddef.h>
+
+#include "list.h"
+#include "pagetable_generic.h"
+#include "vpnmap.h"
+
+// Pages recently evicted by an adaptive policy, remembered without holding
+// a frame. A ghost is identified by its page's page table entry, which
+// stays at the same address for the whole simulation. Each ghost is on one
+// of a few lists kept in LRU order (least recent at the head), and is found
+// by pte through a hash map, so every operation is O(1).
+
+#define GHOST_MAX_LISTS 2
+
+struct ghost
+{
+  list_entry link;
+  struct pt_entry_s* pte;
+  int list;
+};
+
+struct ghost_lists
+{
+  struct ghost* pool;
+  list_head free;
+  struct vpnmap index; // pte -> position in pool
+  list_head lists[GHOST_MAX_LISTS];
+  size_t len[GHOST_MAX_LISTS];
+};
+
+void
+ghost_init(struct ghost_lists* g, size_t capacity);
+void
+ghost_destroy(struct ghost_lists* g);
+int
+ghost_find(struct ghost_lists* g, struct pt_entry_s* pte);
+void
+ghost_add(struct ghost_lists* g, int list, struct pt_entry_s* pte);
+void
+ghost_remove(struct ghost_lists* g, struct pt_entry_s* pte);
+void
+ghost_remove_lru(struct ghost_lists* g, int list);
+
+#endif /* CSC369_GHOST_H */
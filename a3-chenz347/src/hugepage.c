@@ -0,0 +1,91 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "hugepage.h"
+#include "pagetable.h"
+#include "vpnmap.h"
+
+bool hugepage_enabled = false;
+unsigned int hugepage_order;
+size_t hugepage_pages;
+size_t hugepage_threshold;
+
+// Resident pages of each run that has any
+static _Thread_local struct vpnmap runs;
+
+/*
+ * Enables huge pages of 2^order base pages, given as "order[:threshold]".
+ * The order is at most the bits of a page table index, so that a huge page
+ * never straddles two page tables. The threshold defaults to full
+ * population (every page of the run resident); 1 promotes on the first
+ * touch. Returns 0 on success, -1 if spec is invalid.
+ */
+int
+hugepage_configure(const char* spec)
+{
+  char* end;
+  unsigned long order = strtoul(spec, &end, 10);
+  if (end == spec || order == 0 || (1UL << order) > PTRS_PER_PT) {
+    return -1;
+  }
+  size_t pages = 1UL << order;
+  size_t threshold = pages;
+  if (*end == ':') {
+    const char* s = end + 1;
+    threshold = strtoul(s, &end, 10);
+    if (end == s || threshold == 0 || threshold > pages) {
+      return -1;
+    }
+  }
+  if (*end != '\0') {
+    return -1;
+  }
+
+  hugepage_order = order;
+  hugepage_pages = pages;
+  hugepage_threshold = threshold;
+  hugepage_enabled = true;
+  return 0;
+}
+
+void
+hugepage_init(void)
+{
+  if (hugepage_enabled) {
+    vpnmap_init(&runs);
+  }
+}
+
+void
+hugepage_destroy(void)
+{
+  if (hugepage_enabled) {
+    vpnmap_destroy(&runs);
+  }
+}
+
+/* Counts a page brought into memory. Returns the resident pages of its run. */
+size_t
+hugepage_add_resident(vaddr_t key)
+{
+  return ++*vpnmap_lookup(&runs, hugepage_run(key), NULL);
+}
+
+/* Counts a page evicted. Returns the resident pages left in its run. */
+size_t
+hugepage_remove_resident(vaddr_t key)
+{
+  uint64_t* n = vpnmap_find(&runs, hugepage_run(key));
+  if (--*n == 0) {
+    vpnmap_remove(&runs, hugepage_run(key));
+    return 0;
+  }
+  return *n;
+}
+
+size_t
+hugepage_resident(vaddr_t key)
+{
+  uint64_t* n = vpnmap_find(&runs, hugepage_run(key));
+  return n ? *n : 0;
+}
@@ -0,0 +1,51 @@
+#ifndef CSC369_HUGEPAGE_H
+#define CSC369_HUGEPAGE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "pagetable_generic.h"
+
+// Optional huge pages. A huge page maps an aligned run of 2^order base pages
+// of one process (order 9 is a 2MB page), which share a single TLB entry and
+// a single dirty bit. A run is promoted once threshold of its pages are
+// resident: the missing ones are brought in first, as khugepaged would.
+// When the replacement policy picks a frame of a huge page, the huge page
+// is split back into base pages and only that frame is evicted. Each
+// instance keeps its own count of resident pages per run.
+
+extern bool hugepage_enabled;
+extern unsigned int hugepage_order;
+extern size_t hugepage_pages;     // 2^order
+extern size_t hugepage_threshold; // resident pages that trigger promotion
+
+int
+hugepage_configure(const char* spec);
+void
+hugepage_init(void);
+void
+hugepage_destroy(void);
+
+// Run that the page with the given page key (see PAGE_KEY) belongs to
+static inline vaddr_t
+hugepage_run(vaddr_t key)
+{
+  return key >> hugepage_order;
+}
+
+// TLB key of a huge page, which never collides with a page key
+static inline vaddr_t
+hugepage_tlb_key(vaddr_t key)
+{
+  return hugepage_run(key) | (1UL << 63);
+}
+
+size_t
+hugepage_add_resident(vaddr_t key);
+size_t
+hugepage_remove_resident(vaddr_t key);
+size_t
+hugepage_resident(vaddr_t key);
+
+#endif /* CSC369_HUGEPAGE_H */
@@ -0,0 +1,189 @@
+/*
+ * Merges several traces into one multi-process trace, as if each trace were
+ * a process on a time-shared machine. Trace i becomes process i, and the
+ * processes take turns in argument order: each turn replays quantum x weight
+ * references of one process (weight defaults to 1). A process that runs out
+ * of references leaves the rotation.
+ *
+ * Inputs may be in any format sim reads. The output is a text trace with
+ * the pid as a fourth field, or with -b a binary trace.
+ *
+ * USAGE: interleave [-q quantum] [-b] -o output trace[:weight] ...
+ */
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "trace.h"
+
+#define DEFAULT_QUANTUM 1000
+
+struct input
+{
+  const char* path;
+  size_t weight;
+  trace_t trace;
+  bool done;
+};
+
+static FILE* out;
+static const char* out_path;
+static bool binary;
+static struct trace_bin_header hdr;
+
+static void
+write_record(uint64_t rec)
+{
+  if (fwrite(&rec, sizeof(rec), 1, out) != 1) {
+    perror(out_path);
+    exit(1);
+  }
+  hdr.count++;
+}
+
+/*
+ * Splits "path:weight" into its path and weight. An argument without a
+ * numeric suffix is all path, with weight 1. Returns 0 on success.
+ */
+static int
+parse_input(char* arg, struct input* in)
+{
+  in->path = arg;
+  in->weight = 1;
+  char* colon = strrchr(arg, ':');
+  if (colon == NULL) {
+    return 0;
+  }
+  char* end;
+  unsigned long weight = strtoul(colon + 1, &end, 10);
+  if (colon[1] == '\0' || *end != '\0') {
+    return 0;
+  }
+  if (weight == 0) {
+    return -1;
+  }
+  *colon = '\0';
+  in->weight = weight;
+  return 0;
+}
+
+int
+main(int argc, char* argv[])
+{
+  size_t quantum = DEFAULT_QUANTUM;
+  const char* usage =
+    "USAGE: interleave [-q quantum] [-b] -o output trace[:weight] ...\n";
+
+  int opt;
+  while ((opt = getopt(argc, argv, "q:bo:")) != -1) {
+    switch (opt) {
+      case 'q':
+        quantum = strtoul(optarg, NULL, 10);
+        break;
+      case 'b':
+        binary = true;
+        break;
+      case 'o':
+        out_path = optarg;
+        break;
+      default:
+        fprintf(stderr, "%s", usage);
+        return 1;
+    }
+  }
+  size_t num_inputs = argc - optind;
+  if (!out_path || quantum == 0 || num_inputs == 0) {
+    fprintf(stderr, "%s", usage);
+    return 1;
+  }
+  if (num_inputs > TRACE_MAX_PID + 1) {
+    fprintf(stderr, "Error: at most %d traces\n", TRACE_MAX_PID + 1);
+    return 1;
+  }
+
+  struct input* inputs = calloc(num_inputs, sizeof(struct input));
+  if (!inputs) {
+    perror("interleave");
+    return 1;
+  }
+  for (size_t i = 0; i < num_inputs; i++) {
+    if (parse_input(argv[optind + i], &inputs[i]) != 0) {
+      fprintf(stderr, "Error: invalid weight - %s\n", argv[optind + i]);
+      return 1;
+    }
+    if (trace_open(&inputs[i].trace, inputs[i].path) != 0) {
+      return 1;
+    }
+  }
+
+  out = fopen(out_path, binary ? "wb" : "w");
+  if (!out) {
+    perror(out_path);
+    return 1;
+  }
+  // The count is patched in once every trace has been read
+  if (binary) {
+    memcpy(hdr.magic, TRACE_BIN_MAGIC, sizeof(hdr.magic));
+    hdr.version = TRACE_BIN_VERSION;
+    hdr.record_size = sizeof(uint64_t);
+    if (fwrite(&hdr, sizeof(hdr), 1, out) != 1) {
+      perror(out_path);
+      return 1;
+    }
+  }
+
+  size_t refs = 0;
+  size_t switches = 0;
+  size_t running = num_inputs;
+  size_t last_pid = 0; // references before any pid record are process 0's
+  while (running > 0) {
+    for (size_t pid = 0; pid < num_inputs; pid++) {
+      struct input* in = &inputs[pid];
+      if (in->done) {
+        continue;
+      }
+      size_t slice = quantum * in->weight;
+      struct trace_ref ref;
+      size_t n = 0;
+      while (n < slice && trace_next(&in->trace, &ref)) {
+        if (n++ == 0 && binary && pid != last_pid) {
+          write_record(trace_encode_pid(pid));
+          last_pid = pid;
+        }
+        if (binary) {
+          write_record(trace_encode(&ref));
+        } else {
+          fprintf(out, "%c %lx %hhu %zu\n", ref.type, ref.vaddr, ref.val, pid);
+        }
+      }
+      refs += n;
+      switches += n > 0;
+      if (n < slice) {
+        in->done = true;
+        running--;
+        trace_close(&in->trace);
+      }
+    }
+  }
+
+  if (binary && (fseek(out, 0, SEEK_SET) != 0 ||
+                 fwrite(&hdr, sizeof(hdr), 1, out) != 1)) {
+    perror(out_path);
+    return 1;
+  }
+  if (ferror(out) || fclose(out) != 0) {
+    perror(out_path);
+    return 1;
+  }
+  free(inputs);
+
+  printf("%s: %zu references from %zu processes, %zu time slices\n",
+         out_path,
+         refs,
+         num_inputs,
+         switches);
+  return 0;
+}
@@ -0,0 +1,250 @@
+#include <assert.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "list.h"
+#include "pagetable.h"
+#include "pagetable_generic.h"
+#include "sim.h"
+#include "vpnmap.h"
+
+// Low Inter-reference Recency Set (Jiang and Zhang, SIGMETRICS '02). Pages
+// whose last two references were close together are LIR and stay resident;
+// the rest are HIR, and only a few frames (1%) hold resident HIR pages,
+// which are evicted in FIFO order from the queue Q. The stack S orders
+// pages by recency, down to the least recent LIR page at the bottom, and
+// also holds HIR pages (resident or not) that are more recent than it. A
+// HIR page referenced again while in S has a smaller reuse distance than
+// the bottom LIR page, so the two swap status.
+//
+// The history of non-resident HIR pages is bounded to memsize pages: the
+// page that left memory first is forgotten first. S and Q are kept with
+// the most recent page at the tail.
+
+struct lirs_page
+{
+  list_entry stack; // position in S, or unlinked
+  list_entry queue; // position in Q, in the non-resident FIFO or free list
+  struct pt_entry_s* pte;
+  int frame; // -1 when not resident
+  bool lir;
+};
+
+static _Thread_local struct lirs_page* lirs_pool;
+static _Thread_local list_head lirs_free;
+static _Thread_local struct lirs_page** lirs_frame_page; // NULL once evicted
+static _Thread_local struct vpnmap lirs_nonresident; // pte -> pool index
+static _Thread_local list_head lirs_s;
+static _Thread_local list_head lirs_q;
+static _Thread_local list_head lirs_nr; // non-resident HIR pages in S
+static _Thread_local size_t lirs_nr_len;
+static _Thread_local size_t lirs_lir_len;
+static _Thread_local size_t lirs_lir_max;
+
+static struct lirs_page*
+lirs_bottom(void)
+{
+  return container_of(lirs_s.head.next, struct lirs_page, stack);
+}
+
+static struct lirs_page*
+lirs_alloc(struct pt_entry_s* pte, int frame)
+{
+  assert(lirs_free.head.next != &lirs_free.head);
+  struct lirs_page* p =
+    container_of(lirs_free.head.next, struct lirs_page, queue);
+  list_del(&p->queue);
+  list_entry_init(&p->stack);
+  p->pte = pte;
+  p->frame = frame;
+  return p;
+}
+
+static void
+lirs_release(struct lirs_page* p)
+{
+  list_add_tail(&lirs_free, &p->queue);
+}
+
+/* Forgets a non-resident page: it leaves S and the non-resident FIFO. */
+static void
+lirs_forget(struct lirs_page* p)
+{
+  list_del(&p->stack);
+  list_del(&p->queue);
+  lirs_nr_len--;
+  vpnmap_remove(&lirs_nonresident, (uintptr_t)p->pte);
+  lirs_release(p);
+}
+
+/* Removes HIR pages from the bottom of S until a LIR page is there. */
+static void
+lirs_prune(void)
+{
+  while (lirs_s.head.next != &lirs_s.head && !lirs_bottom()->lir) {
+    struct lirs_page* p = lirs_bottom();
+    if (p->frame == -1) {
+      lirs_forget(p);
+    } else {
+      list_del(&p->stack); // still on Q
+    }
+  }
+}
+
+static void
+lirs_to_top(struct lirs_page* p)
+{
+  if (list_entry_is_linked(&p->stack)) {
+    list_del(&p->stack);
+  }
+  list_add_tail(&lirs_s, &p->stack);
+}
+
+/*
+ * Turns the least recent LIR page of S into a resident HIR page at the end
+ * of Q. HIR pages below it (only there while S holds no other LIR page) are
+ * pruned first.
+ */
+static void
+lirs_demote_bottom(void)
+{
+  lirs_prune();
+  assert(lirs_s.head.next != &lirs_s.head);
+  struct lirs_page* p = lirs_bottom();
+  p->lir = false;
+  list_del(&p->stack);
+  list_add_tail(&lirs_q, &p->queue);
+  lirs_prune();
+}
+
+/* Page to evict is chosen using the LIRS algorithm: the resident HIR page
+ * at the front of Q.
+ * Returns the page frame number (which is also the index in the coremap)
+ * for the page that is to be evicted.
+ */
+int
+lirs_evict(void)
+{
+  if (lirs_q.head.next == &lirs_q.head) {
+    // Every frame holds a LIR page, which only happens with a single frame
+    lirs_demote_bottom();
+    lirs_lir_len--;
+  }
+  struct lirs_page* p = container_of(lirs_q.head.next, struct lirs_page, queue);
+  list_del(&p->queue);
+  int frame = p->frame;
+  lirs_frame_page[frame] = NULL;
+  p->frame = -1;
+
+  if (!list_entry_is_linked(&p->stack)) {
+    lirs_release(p);
+    return frame;
+  }
+
+  // Still in S: remember it as a non-resident HIR page
+  *vpnmap_lookup(&lirs_nonresident, (uintptr_t)p->pte, NULL) = p - lirs_pool;
+  list_add_tail(&lirs_nr, &p->queue);
+  if (++lirs_nr_len > memsize) {
+    lirs_forget(container_of(lirs_nr.head.next, struct lirs_page, queue));
+  }
+  return frame;
+}
+
+/* This function is called on each access to a page to update any information
+ * needed by the LIRS algorithm.
+ * Input: The page table entry for the page that is being accessed.
+ */
+void
+lirs_ref(int frame)
+{
+  struct lirs_page* p = lirs_frame_page[frame];
+  if (p != NULL) {
+    if (p->lir) {
+      bool bottom = &p->stack == lirs_s.head.next;
+      lirs_to_top(p);
+      if (bottom) {
+        lirs_prune();
+      }
+    } else if (list_entry_is_linked(&p->stack)) {
+      // Resident HIR page with a short reuse distance
+      lirs_to_top(p);
+      list_del(&p->queue);
+      p->lir = true;
+      lirs_demote_bottom();
+    } else {
+      lirs_to_top(p);
+      list_del(&p->queue);
+      list_add_tail(&lirs_q, &p->queue);
+    }
+    return;
+  }
+
+  // Faulted in
+  struct pt_entry_s* pte = coremap[frame].pte;
+  uint64_t* pos = vpnmap_find(&lirs_nonresident, (uintptr_t)pte);
+  if (pos != NULL) {
+    // A non-resident HIR page still in S becomes LIR
+    p = &lirs_pool[*pos];
+    vpnmap_remove(&lirs_nonresident, (uintptr_t)pte);
+    list_del(&p->queue);
+    lirs_nr_len--;
+    p->frame = frame;
+    lirs_frame_page[frame] = p;
+    lirs_to_top(p);
+    p->lir = true;
+    lirs_demote_bottom();
+    return;
+  }
+
+  p = lirs_alloc(pte, frame);
+  lirs_frame_page[frame] = p;
+  list_add_tail(&lirs_s, &p->stack);
+  if (lirs_lir_len < lirs_lir_max) {
+    p->lir = true;
+    lirs_lir_len++;
+  } else {
+    p->lir = false;
+    list_add_tail(&lirs_q, &p->queue);
+  }
+}
+
+/* Initialize any data structures needed for this replacement algorithm. */
+void
+lirs_init(void)
+{
+  // memsize resident pages and up to memsize non-resident ones
+  lirs_pool = malloc(2 * memsize * sizeof(struct lirs_page));
+  lirs_frame_page = calloc(memsize, sizeof(struct lirs_page*));
+  if (!lirs_pool || !lirs_frame_page) {
+    perror("lirs_init");
+    exit(1);
+  }
+  list_init(&lirs_free);
+  for (size_t i = 0; i < 2 * memsize; i++) {
+    list_add_tail(&lirs_free, &lirs_pool[i].queue);
+  }
+  vpnmap_init(&lirs_nonresident);
+  list_init(&lirs_s);
+  list_init(&lirs_q);
+  list_init(&lirs_nr);
+  lirs_nr_len = 0;
+  lirs_lir_len = 0;
+  // At least one LIR page, and one resident HIR page if there is room
+  size_t hir_max = memsize / 100 > 1 ? memsize / 100 : 1;
+  if (hir_max > memsize - 1) {
+    hir_max = memsize - 1;
+  }
+  lirs_lir_max = memsize - hir_max;
+}
+
+/* Cleanup any data structures created in lirs_init(). */
+void
+lirs_cleanup(void)
+{
+  free(lirs_pool);
+  free(lirs_frame_page);
+  lirs_pool = NULL;
+  lirs_frame_page = NULL;
+  vpnmap_destroy(&lirs_nonresident);
+}
@@ -1,11 +1,15 @@
-#include <assert.h>
-#include <stdlib.h>
 #include <stdio.h>
-#include "sim.h"
-#include "pagetable.h"
+#include <stdlib.h>
+
+#include "coremap.h"
 #include "pagetable_generic.h"
-#define MYPRINTF(a)  //printf a
-static list_head g_list_head;
+#include "sim.h"
+
+// Frames are kept on a single list in order of their last reference, least
+// recently used at the head.
+
+static _Thread_local struct frame_links lru_links;
+
 /* Page to evict is chosen using the accurate LRU algorithm.
  * Returns the page frame number (which is also the index in the coremap)
  * for the page that is to be evicted.
@@ -13,19 +17,9 @@ static list_head g_list_head;
 int
 lru_evict(void)
 {
-  /* Remove the first one from list */
-  struct list_entry *del_pos = g_list_head.head.next;
-  list_del(del_pos);
-  struct frame * frame_ptr = container_of(del_pos,struct frame,double_list);
-  #if 1
-  return frame_ptr->frame_id;
-  #else
-  for (size_t i = 0; i < memsize; i++) {
-    if(&coremap[i] == frame_ptr)
-      return i;
-  }
-  return 0;
-  #endif
+  uint32_t frame = frame_list_first(&lru_links, 0);
+  frame_list_del(&lru_links, frame);
+  return frame;
 }
 
 /* This function is called on each access to a page to update any information
@@ -35,23 +29,19 @@ lru_evict(void)
 void
 lru_ref(int frame)
 {
-  MYPRINTF(("lru_ref in:%d\n",frame));
-  if((coremap[frame].double_list.next != NULL) &&
-     (coremap[frame].double_list.prev != NULL))
-    list_del(&coremap[frame].double_list);
-  list_add_tail(&g_list_head,&coremap[frame].double_list);
+  if (frame_list_contains(&lru_links, frame)) {
+    frame_list_del(&lru_links, frame);
+  }
+  frame_list_add_tail(&lru_links, 0, frame);
 }
 
 /* Initialize any data structures needed for this replacement algorithm. */
 void
 lru_init(void)
 {
-  MYPRINTF(("lru_ref lru_init\n"));
-  /* linked list initialization */
-  list_init(&g_list_head);
-  for (size_t i = 0; i < memsize; i++) {
-    list_entry_init(&coremap[i].double_list);
-    coremap[i].frame_id = i;
+  if (frame_links_init(&lru_links, memsize, 1) != 0) {
+    perror("lru_init");
+    exit(1);
   }
 }
 
@@ -59,4 +49,5 @@ lru_init(void)
 void
 lru_cleanup(void)
 {
+  frame_links_destroy(&lru_links);
 }
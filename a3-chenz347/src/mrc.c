@@ -0,0 +1,209 @@
+/*
+ * Computes the LRU hit rate for every memory size in a single pass over a
+ * trace, using Mattson's stack algorithm.
+ *
+ * Under LRU, a reference hits in a memory of M frames exactly when fewer than
+ * M distinct other pages were referenced since the previous reference to the
+ * same page (its stack distance). The distance is the number of pages whose
+ * most recent reference falls after that previous reference. A Fenwick tree
+ * over reference times, holding a 1 at each page's most recent reference,
+ * answers that in O(log N). A histogram of distances then gives the hit
+ * count for every M at once.
+ *
+ * USAGE: mrc -f tracefile [-m maxmemsize] [-i interval]
+ *
+ * Prints a CSV with one row per memory size: memsize,hits,hit_rate
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "trace.h"
+#include "vpnmap.h"
+
+// Most recent reference time of each page
+static struct vpnmap last_ref;
+
+//---------------------------------------------------------------------
+// Fenwick tree over reference times 1..capacity.
+
+static uint32_t* fenwick;
+static uint64_t capacity;
+static uint64_t now; // time of the latest reference
+
+static void
+fenwick_add(uint64_t i, int32_t delta)
+{
+  for (; i <= capacity; i += i & -i) {
+    fenwick[i] += delta;
+  }
+}
+
+// Sum of marks at times 1..i
+static uint64_t
+fenwick_sum(uint64_t i)
+{
+  uint64_t sum = 0;
+  for (; i > 0; i -= i & -i) {
+    sum += fenwick[i];
+  }
+  return sum;
+}
+
+static int
+cmp_time(const void* a, const void* b)
+{
+  uint64_t ta = (*(struct vpnmap_entry* const*)a)->value;
+  uint64_t tb = (*(struct vpnmap_entry* const*)b)->value;
+  return (ta > tb) - (ta < tb);
+}
+
+/*
+ * Renumbers the most recent reference times as 1..num_pages, preserving
+ * their order, and rebuilds the tree with room to grow. This keeps memory
+ * proportional to the number of distinct pages rather than the trace length.
+ */
+static void
+fenwick_compact(void)
+{
+  size_t num_pages = last_ref.count;
+  struct vpnmap_entry** order =
+    malloc(num_pages * sizeof(struct vpnmap_entry*));
+  if (num_pages > 0 && !order) {
+    perror("mrc");
+    exit(1);
+  }
+  size_t n = 0;
+  for (size_t i = 0; i < last_ref.size; i++) {
+    if (last_ref.slots[i].key != 0) {
+      order[n++] = &last_ref.slots[i];
+    }
+  }
+  qsort(order, n, sizeof(order[0]), cmp_time);
+
+  free(fenwick);
+  capacity = 2 * num_pages < 65536 ? 65536 : 2 * num_pages;
+  fenwick = calloc(capacity + 1, sizeof(uint32_t));
+  if (!fenwick) {
+    perror("mrc");
+    exit(1);
+  }
+  for (size_t i = 0; i < n; i++) {
+    order[i]->value = i + 1;
+    fenwick_add(i + 1, 1);
+  }
+  now = n;
+  free(order);
+}
+
+//---------------------------------------------------------------------
+
+int
+main(int argc, char* argv[])
+{
+  char* tracefile = NULL;
+  size_t max_mem = 0;
+  size_t interval = 1;
+  const char* usage =
+    "USAGE: mrc -f tracefile [-m maxmemsize] [-i interval]\n";
+
+  int opt;
+  while ((opt = getopt(argc, argv, "f:m:i:")) != -1) {
+    switch (opt) {
+      case 'f':
+        tracefile = optarg;
+        break;
+      case 'm':
+        max_mem = strtoul(optarg, NULL, 10);
+        break;
+      case 'i':
+        interval = strtoul(optarg, NULL, 10);
+        break;
+      default:
+        fprintf(stderr, "%s", usage);
+        return 1;
+    }
+  }
+  if (!tracefile || interval == 0) {
+    fprintf(stderr, "%s", usage);
+    return 1;
+  }
+
+  trace_t trace;
+  if (trace_open(&trace, tracefile) != 0) {
+    return 1;
+  }
+
+  vpnmap_init(&last_ref);
+  // hist[d] counts references with stack distance d, growing as needed
+  size_t hist_size = 1024;
+  uint64_t* hist = calloc(hist_size, sizeof(uint64_t));
+  if (!hist) {
+    perror("mrc");
+    return 1;
+  }
+  fenwick_compact();
+
+  uint64_t refs = 0;
+  struct trace_ref ref;
+  while (trace_next(&trace, &ref)) {
+    refs++;
+    if (now == capacity) {
+      fenwick_compact();
+    }
+    now++;
+
+    // A first reference is a compulsory miss at every memory size
+    bool first;
+    uint64_t key = PAGE_KEY(ref.pid, ref.vaddr);
+    uint64_t* last = vpnmap_lookup(&last_ref, key, &first);
+    if (!first) {
+      uint64_t dist = last_ref.count - fenwick_sum(*last);
+      if (dist >= hist_size) {
+        size_t new_size = hist_size;
+        while (dist >= new_size) {
+          new_size *= 2;
+        }
+        hist = realloc(hist, new_size * sizeof(uint64_t));
+        if (!hist) {
+          perror("mrc");
+          return 1;
+        }
+        memset(hist + hist_size, 0, (new_size - hist_size) * sizeof(uint64_t));
+        hist_size = new_size;
+      }
+      hist[dist]++;
+      fenwick_add(*last, -1);
+    }
+    *last = now;
+    fenwick_add(now, 1);
+  }
+  trace_close(&trace);
+
+  // Beyond one frame per page nothing is ever evicted, so the curve is flat
+  if (max_mem == 0 || max_mem > last_ref.count) {
+    max_mem = last_ref.count;
+  }
+
+  printf("memsize,hits,hit_rate\n");
+  uint64_t hits = 0;
+  for (size_t m = 1; m <= max_mem; m++) {
+    if (m - 1 < hist_size) {
+      hits += hist[m - 1];
+    }
+    if (m % interval == 0 || m == max_mem) {
+      printf("%zu,%llu,%.4f\n",
+             m,
+             (unsigned long long)hits,
+             refs ? ((double)hits / refs) * 100.0 : 0.0);
+    }
+  }
+
+  free(hist);
+  vpnmap_destroy(&last_ref);
+  free(fenwick);
+  return 0;
+}
@@ -0,0 +1,275 @@
+#include <assert.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "engine.h"
+#include "pagetable_generic.h"
+#include "sim.h"
+#include "trace.h"
+#include "vpnmap.h"
+
+// Belady's OPT evicts the page whose next use is furthest in the future.
+//
+// opt_init reads the whole trace ahead of the simulation and, walking it
+// backwards, records for every reference the position of the next reference
+// to the same page. Resident frames are kept in a max-heap keyed by the next
+// use of the page they hold, so each reference and eviction costs O(log M).
+// These next uses depend only on the trace, so a caller replaying one trace
+// in several instances can build them once with opt_trace_from_records and
+// share them read-only through opt_shared_trace.
+//
+// A page brought in without a reference (see prefetching) takes no trace
+// position. Its next use is 1 + the position of its next reference (0 if
+// none), looked up in next_ref for pages evicted, and otherwise in the
+// first references of the trace, as the page was never referenced yet.
+
+#define OPT_NEVER SIZE_MAX // the page is not referenced again
+
+struct opt_trace
+{
+  size_t* next_use; // next_use[i] for reference i
+  size_t num_refs;
+  struct vpnmap first_ref; // 1 + the position of the first reference
+};
+
+_Thread_local struct opt_trace* opt_shared_trace = NULL;
+
+static _Thread_local struct opt_trace* own_trace; // if none is shared
+static _Thread_local struct opt_trace* trace;
+static _Thread_local size_t opt_pos; // index of the current reference
+static _Thread_local struct vpnmap next_ref; // next use of evicted pages
+
+static _Thread_local int* heap;           // frames, max-heap on frame_key
+static _Thread_local size_t* frame_key;   // next use of the page in frame
+static _Thread_local size_t* heap_index;  // position of frame in heap
+static _Thread_local size_t heap_len;
+
+#define HEAP_ABSENT SIZE_MAX
+
+static void
+heap_swap(size_t a, size_t b)
+{
+  int fa = heap[a];
+  int fb = heap[b];
+  heap[a] = fb;
+  heap[b] = fa;
+  heap_index[fb] = a;
+  heap_index[fa] = b;
+}
+
+static void
+heap_sift_up(size_t i)
+{
+  while (i > 0) {
+    size_t parent = (i - 1) / 2;
+    if (frame_key[heap[parent]] >= frame_key[heap[i]]) {
+      break;
+    }
+    heap_swap(i, parent);
+    i = parent;
+  }
+}
+
+static void
+heap_sift_down(size_t i)
+{
+  while (1) {
+    size_t largest = i;
+    size_t left = 2 * i + 1;
+    size_t right = left + 1;
+    if (left < heap_len && frame_key[heap[left]] > frame_key[heap[largest]]) {
+      largest = left;
+    }
+    if (right < heap_len && frame_key[heap[right]] > frame_key[heap[largest]]) {
+      largest = right;
+    }
+    if (largest == i) {
+      return;
+    }
+    heap_swap(i, largest);
+    i = largest;
+  }
+}
+
+/* Page to evict is chosen using the OPT algorithm.
+ * Returns the page frame number (which is also the index in the coremap)
+ * for the page that is to be evicted.
+ */
+int
+opt_evict(void)
+{
+  assert(heap_len > 0);
+  // The victim stays in the heap; opt_ref rekeys it for its new page.
+  int frame = heap[0];
+  *vpnmap_lookup(&next_ref, coremap[frame].vpn, NULL) = frame_key[frame] + 1;
+  return frame;
+}
+
+/* This function is called on each access to a page to update any information
+ * needed by the OPT algorithm.
+ * Input: The page table entry for the page that is being accessed.
+ */
+void
+opt_ref(int frame)
+{
+  size_t old_key = frame_key[frame];
+  if (prefetching) {
+    uint64_t* next = vpnmap_find(&next_ref, coremap[frame].vpn);
+    if (!next) {
+      next = vpnmap_find(&trace->first_ref, coremap[frame].vpn);
+    }
+    frame_key[frame] = next && *next ? *next - 1 : OPT_NEVER;
+  } else if (opt_pos < trace->num_refs) {
+    frame_key[frame] = trace->next_use[opt_pos++];
+  } else {
+    fprintf(stderr, "opt: trace has more references than %s\n", tracefile);
+    exit(1);
+  }
+
+  if (heap_index[frame] == HEAP_ABSENT) {
+    heap[heap_len] = frame;
+    heap_index[frame] = heap_len;
+    heap_sift_up(heap_len++);
+  } else if (frame_key[frame] > old_key) {
+    heap_sift_up(heap_index[frame]);
+  } else {
+    heap_sift_down(heap_index[frame]);
+  }
+}
+
+/*
+ * Replaces the page key of each of the ot->num_refs references in
+ * ot->next_use with the position of the next reference to the same page,
+ * and records the first reference to every page.
+ */
+static void
+opt_trace_index(struct opt_trace* ot)
+{
+  vpnmap_init(&ot->first_ref);
+  for (size_t i = ot->num_refs; i-- > 0;) {
+    bool first;
+    uint64_t* next = vpnmap_lookup(&ot->first_ref, ot->next_use[i], &first);
+    ot->next_use[i] = first ? OPT_NEVER : *next - 1;
+    *next = i + 1;
+  }
+}
+
+/*
+ * Reads the page key of every reference in the trace (of this instance's
+ * process only, if it has one), then indexes them.
+ */
+static struct opt_trace*
+opt_trace_read(void)
+{
+  trace_t t;
+  if (trace_open(&t, tracefile) != 0) {
+    exit(1);
+  }
+
+  struct opt_trace* ot = malloc(sizeof(struct opt_trace));
+  size_t cap = t.map ? t.count : 1 << 20;
+  size_t* keys = ot ? malloc(cap * sizeof(size_t)) : NULL;
+  size_t n = 0;
+  struct trace_ref ref;
+  while (keys && trace_next(&t, &ref)) {
+    if (instance_pid >= 0 && ref.pid != instance_pid) {
+      continue;
+    }
+    if (n == cap) {
+      cap *= 2;
+      keys = realloc(keys, cap * sizeof(size_t));
+      if (!keys) {
+        break;
+      }
+    }
+    keys[n++] = PAGE_KEY(ref.pid, ref.vaddr);
+  }
+  trace_close(&t);
+  if (!keys) {
+    perror("opt_init");
+    exit(1);
+  }
+
+  ot->next_use = keys;
+  ot->num_refs = n;
+  opt_trace_index(ot);
+  return ot;
+}
+
+/*
+ * Builds the next uses of the references of all processes in count encoded
+ * trace records, to be shared through opt_shared_trace by instances that
+ * replay them. Returns NULL if out of memory.
+ */
+struct opt_trace*
+opt_trace_from_records(const uint64_t* records, size_t count)
+{
+  struct opt_trace* ot = malloc(sizeof(struct opt_trace));
+  size_t* keys = ot ? malloc((count ? count : 1) * sizeof(size_t)) : NULL;
+  if (!keys) {
+    free(ot);
+    return NULL;
+  }
+  size_t n = 0;
+  unsigned short pid = 0;
+  struct trace_ref ref;
+  for (size_t i = 0; i < count; i++) {
+    if (trace_decode(records[i], &pid, &ref)) {
+      keys[n++] = PAGE_KEY(ref.pid, ref.vaddr);
+    }
+  }
+  ot->next_use = keys;
+  ot->num_refs = n;
+  opt_trace_index(ot);
+  return ot;
+}
+
+void
+opt_trace_free(struct opt_trace* ot)
+{
+  if (ot) {
+    free(ot->next_use);
+    vpnmap_destroy(&ot->first_ref);
+    free(ot);
+  }
+}
+
+/* Initialize any data structures needed for this replacement algorithm. */
+void
+opt_init(void)
+{
+  own_trace = opt_shared_trace ? NULL : opt_trace_read();
+  trace = opt_shared_trace ? opt_shared_trace : own_trace;
+  opt_pos = 0;
+  vpnmap_init(&next_ref);
+
+  heap = malloc(memsize * sizeof(int));
+  frame_key = malloc(memsize * sizeof(size_t));
+  heap_index = malloc(memsize * sizeof(size_t));
+  if (!heap || !frame_key || !heap_index) {
+    perror("opt_init");
+    exit(1);
+  }
+  for (size_t i = 0; i < memsize; i++) {
+    heap_index[i] = HEAP_ABSENT;
+    frame_key[i] = 0;
+  }
+  heap_len = 0;
+}
+
+/* Cleanup any data structures created in opt_init(). */
+void
+opt_cleanup(void)
+{
+  opt_trace_free(own_trace);
+  vpnmap_destroy(&next_ref);
+  free(heap);
+  free(frame_key);
+  free(heap_index);
+  own_trace = NULL;
+  trace = NULL;
+  heap = NULL;
+  frame_key = NULL;
+  heap_index = NULL;
+}
@@ -17,81 +17,129 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include "hugepage.h"
 #include "pagetable.h"
 #include "pagetable_generic.h"
+#include "readahead.h"
+#include "timeseries.h"
 #include "sim.h"
 #include "swap.h"
+#include "tlb.h"
 
 // Counters for various events.
 // Your code must increment these when the related events occur.
-size_t hit_count = 0;   /* hits */
-size_t miss_count = 0;  /* misses */
-size_t ref_count = 0;   /* references */
-size_t evict_clean_count = 0; /* clean pages evicted */
-size_t evict_dirty_count = 0; /* dirty pages evicted */
+_Thread_local size_t hit_count = 0;   /* hits */
+_Thread_local size_t miss_count = 0;  /* misses */
+_Thread_local size_t ref_count = 0;   /* references */
+_Thread_local size_t evict_clean_count = 0; /* clean pages evicted */
+_Thread_local size_t evict_dirty_count = 0; /* dirty pages evicted */
+_Thread_local size_t tlb_hit_count = 0; /* translations found in the TLB */
+_Thread_local size_t walk_count = 0;    /* page table walks */
+_Thread_local struct hugepage_stats hugepage_stats;
+_Thread_local struct readahead_stats readahead_stats;
+_Thread_local struct proc_stats* proc_stats = NULL;
+_Thread_local size_t num_procs = 0;
+
+// Frames that have never held a page, lowest frame number on top. Pages are
+// never freed in the simulation, so once this empties every allocation goes
+// through evict_func.
+static _Thread_local int* free_frames = NULL;
+static _Thread_local size_t num_free_frames = 0;
+
+_Thread_local pt_entry_t* fault_pte = NULL;
+_Thread_local bool prefetching = false;
+
+/*
+ * Splits the huge page that the page (pte, key) is part of back into base
+ * pages. They keep the huge page's dirty bit.
+ */
+static void
+split_hugepage(pt_entry_t* pte, vaddr_t key)
+{
+  pt_entry_t* run = pte - (key & (hugepage_pages - 1));
+  for (size_t i = 0; i < hugepage_pages; i++) {
+    pte_set_flags(&run[i], pte_flags(&run[i]) & ~PAGE_HUGE);
+  }
+  if (tlb_enabled) {
+    tlb_invalidate(hugepage_tlb_key(key));
+  }
+  hugepage_stats.splits++;
+}
 
 /*
  * Allocates a frame to be used for the virtual page represented by p.
  * If all frames are in use, calls the replacement algorithm's evict_func to
  * select a victim frame. Writes victim to swap if needed, and updates
  * page table entry for victim to indicate that virtual page is no longer in
- * (simulated) physical memory.
+ * (simulated) physical memory. Reading p back from swap, if it is there, is
+ * left to the caller.
  *
  * Counters for evictions should be updated appropriately in this function.
  */
 static int
-allocate_frame(pt_entry_t* pte)
+allocate_frame(pt_entry_t* pte, vaddr_t key)
 {
   int frame = -1;
-  for (size_t i = 0; i < memsize; ++i) {
-    if (!coremap[i].in_use) {
-      frame = i;
-      break;
-    }
-  }
-
-  if (frame == -1) { // Didn't find a free page.
+  if (num_free_frames > 0) {
+    frame = free_frames[--num_free_frames];
+  } else { // No free frames left.
     // Call replacement algorithm's evict function to select victim
+    fault_pte = pte;
     frame = evict_func();
     assert(frame != -1);
 
-    coremap[frame].pte->frame = 0; 
-    if(coremap[frame].pte->flag&PAGE_DIRTY){  /* write dirty page to swp */
+    pt_entry_t* victim = coremap[frame].pte;
+    vaddr_t victim_key = coremap[frame].vpn;
+    unsigned int victim_flags = pte_flags(victim);
+    if (victim_flags & PAGE_HUGE) {
+      split_hugepage(victim, victim_key);
+    }
+    if (hugepage_enabled) {
+      hugepage_remove_resident(victim_key);
+    }
+    if (tlb_enabled) {
+      tlb_invalidate(victim_key);
+    }
+    proc_stats[PAGE_KEY_PID(victim_key)].evict_count++;
+    pte_set_frame(victim, 0);
+    if(victim_flags&PAGE_DIRTY){  /* write dirty page to swp */
       evict_dirty_count++;
-      coremap[frame].pte->swap_offset = swap_pageout(frame,coremap[frame].pte->swap_offset);
+      if (victim_flags & (PAGE_PREFETCHED | PAGE_SHARED_DIRTY)) {
+        hugepage_stats.extra_writes++;
+      }
+      pte_set_swap_offset(victim, swap_pageout(frame,pte_swap_offset(victim)));
     } else {
       evict_clean_count++;
     }
-    coremap[frame].pte->flag = PAGE_REF|PAGE_ONSWAP;
+    pte_set_flags(victim, PAGE_REF|PAGE_ONSWAP);
 
-    /* write to memory if pte in swap */
-    if(pte->flag&PAGE_ONSWAP){
-      pte->frame = frame;
-      swap_pagein(pte->frame,pte->swap_offset);
-    }
     // All frames were in use, so victim frame must hold some page
     // Write victim page to swap, if needed, and update page table
 
     // IMPLEMENTATION NEEDED
   }
-  pte->frame = frame;
+  pte_set_frame(pte, frame);
   // Record information for virtual page that will now be stored in frame
-  coremap[frame].in_use = true;
   coremap[frame].pte = pte;
+  coremap[frame].vpn = key;
+  if (hugepage_enabled) {
+    hugepage_add_resident(key);
+  }
 
   return frame;
 }
 
-static pt_entry_t *g_pt_entry = NULL;
-size_t g_pt_entry_size = 33580336;
+// Top-level page directory pointer table of each process, indexed by pid
+// like proc_stats. A process's table is created on its first reference,
+// and lower levels on first touch, so memory scales with the pages the
+// trace actually uses.
+static _Thread_local pdpt_entry_t** pdpts = NULL;
+
 /*
  * Initializes your page table.
  * This function is called once at the start of the simulation.
- * For the simulation, there is a single "process" whose reference trace is
- * being simulated, so there is just one overall page table.
- *
- * In a real OS, each process would have its own page table, which would
- * need to be allocated and initialized as part of process creation.
+ * Each process in the trace gets its own page table when it first runs,
+ * as it would at process creation in a real OS.
  *
  * The format of the page table, and thus what you need to do to get ready
  * to start translating virtual addresses, is up to you.
@@ -99,13 +147,140 @@ size_t g_pt_entry_size = 33580336;
 void
 init_pagetable(void)
 {
-  g_pt_entry = malloc(sizeof(pt_entry_t)*g_pt_entry_size);
-  for(size_t i = 0;i<g_pt_entry_size;i++) {
-    g_pt_entry[i].flag = 0;
-    g_pt_entry[i].swap_offset = INVALID_SWAP;
-    g_pt_entry[i].frame = 0;
-    g_pt_entry[i].ref = false;
+  free_frames = malloc(memsize * sizeof(int));
+  if (free_frames == NULL) {
+    perror("init_pagetable");
+    exit(1);
+  }
+  for (size_t i = 0; i < memsize; i++) {
+    free_frames[i] = memsize - 1 - i;
+  }
+  num_free_frames = memsize;
+  tlb_init();
+  hugepage_init();
+  readahead_init();
+}
+
+/*
+ * Makes room for processes up to pid and creates the page table of pid,
+ * on the first reference by pid.
+ */
+static void
+add_process(unsigned short pid)
+{
+  if (pid >= num_procs) {
+    size_t n = (size_t)pid + 1;
+    pdpts = realloc(pdpts, n * sizeof(pdpt_entry_t*));
+    proc_stats = realloc(proc_stats, n * sizeof(struct proc_stats));
+    if (pdpts == NULL || proc_stats == NULL) {
+      perror("add_process");
+      exit(1);
+    }
+    memset(&pdpts[num_procs], 0, (n - num_procs) * sizeof(pdpt_entry_t*));
+    memset(&proc_stats[num_procs],
+           0,
+           (n - num_procs) * sizeof(struct proc_stats));
+    num_procs = n;
+  }
+  pdpts[pid] = calloc(PTRS_PER_PDPT, sizeof(pdpt_entry_t));
+  if (pdpts[pid] == NULL) {
+    perror("add_process");
+    exit(1);
+  }
+}
+
+/* Allocates a 2nd-level page directory with every entry invalid. */
+static pd_entry_t*
+alloc_pd(void)
+{
+  pd_entry_t* pd = calloc(PTRS_PER_PD, sizeof(pd_entry_t));
+  if (pd == NULL) {
+    perror("alloc_pd");
+    exit(1);
+  }
+  return pd;
+}
+
+/*
+ * Allocates a 3rd-level page table with every entry unused. An all-zero
+ * entry has no flags, frame 0 and no swap slot.
+ */
+static pt_entry_t*
+alloc_pt(void)
+{
+  pt_entry_t* pt = calloc(PTRS_PER_PT, sizeof(pt_entry_t));
+  if (pt == NULL) {
+    perror("alloc_pt");
+    exit(1);
   }
+  return pt;
+}
+
+/*
+ * Walks the page table of pid for vaddr, allocating any missing page
+ * directory or page table along the way, and returns its page table entry.
+ */
+static pt_entry_t*
+lookup_pte(unsigned short pid, vaddr_t vaddr)
+{
+  size_t pdpt_index = PDPT_INDEX(vaddr);
+  assert(pdpt_index < PTRS_PER_PDPT);
+
+  if (pid >= num_procs || pdpts[pid] == NULL) {
+    add_process(pid);
+  }
+  pdpt_entry_t* pdp = &pdpts[pid][pdpt_index];
+  if (!(pdp->pdp & PAGE_VALID)) {
+    pdp->pdp = (uintptr_t)alloc_pd() | PAGE_VALID;
+  }
+  pd_entry_t* pd = (pd_entry_t*)(pdp->pdp & ~(uintptr_t)PAGE_VALID);
+
+  pd_entry_t* pde = &pd[PD_INDEX(vaddr)];
+  if (!(pde->pde & PAGE_VALID)) {
+    pde->pde = (uintptr_t)alloc_pt() | PAGE_VALID;
+  }
+  pt_entry_t* pt = (pt_entry_t*)(pde->pde & ~(uintptr_t)PAGE_VALID);
+
+  return &pt[PT_INDEX(vaddr)];
+}
+
+/*
+ * Marks a resident page dirty. Its copy on swap, if any, no longer matches,
+ * so the swap slot is released for reuse; the next eviction of this page
+ * writes it to a newly allocated slot.
+ */
+static void
+mark_dirty(pt_entry_t* pte)
+{
+  unsigned int flags = pte_flags(pte);
+  if (flags & PAGE_DIRTY) {
+    return;
+  }
+  off_t offset = pte_swap_offset(pte);
+  if (offset != INVALID_SWAP) {
+    swap_free(offset);
+    pte_set_swap_offset(pte, INVALID_SWAP);
+  }
+  pte_set_flags(pte, flags | PAGE_DIRTY);
+}
+
+/*
+ * Records a write to the resident page (pte, key). A huge page has a single
+ * dirty bit, so writing to any of its pages dirties all of them.
+ */
+static void
+write_page(pt_entry_t* pte, vaddr_t key)
+{
+  unsigned int flags = pte_flags(pte);
+  if ((flags & PAGE_HUGE) && !(flags & PAGE_DIRTY)) {
+    pt_entry_t* run = pte - (key & (hugepage_pages - 1));
+    for (size_t i = 0; i < hugepage_pages; i++) {
+      mark_dirty(&run[i]);
+      pte_set_flags(&run[i], pte_flags(&run[i]) | PAGE_SHARED_DIRTY);
+    }
+  }
+  mark_dirty(pte);
+  pte_set_flags(pte, pte_flags(pte) & ~PAGE_SHARED_DIRTY);
 }
 
 /*
@@ -122,7 +297,179 @@ init_frame(int frame)
 }
 
 /*
- * Locate the physical frame number for the given vaddr using the page table.
+ * Before the fault of the page (pte, key) is handled: if that fault brings
+ * enough of its run into memory to promote it, brings in every other
+ * missing page of the run too. They are zero-filled or read from swap, and
+ * count as prefetched rather than as misses.
+ */
+static void
+collapse_hugepage(pt_entry_t* pte, vaddr_t key)
+{
+  if (hugepage_pages > memsize ||
+      hugepage_resident(key) + 1 < hugepage_threshold) {
+    return;
+  }
+  size_t index = key & (hugepage_pages - 1);
+  pt_entry_t* run = pte - index;
+  for (size_t i = 0; i < hugepage_pages; i++) {
+    unsigned int flags = pte_flags(&run[i]);
+    if (i == index || (flags & PAGE_VALID)) {
+      continue;
+    }
+    int frame = allocate_frame(&run[i], key - index + i);
+    if (flags == 0) {
+      init_frame(frame);
+      pte_set_flags(&run[i], PAGE_VALID | PAGE_DIRTY | PAGE_PREFETCHED);
+    } else {
+      swap_pagein(frame, pte_swap_offset(&run[i]));
+      pte_set_flags(&run[i], PAGE_VALID | PAGE_PREFETCHED);
+    }
+    prefetching = true;
+    ref_func(frame);
+    prefetching = false;
+    hugepage_stats.populated++;
+  }
+}
+
+/*
+ * Maps the run of the page (pte, key), now entirely resident, as a huge
+ * page. Its pages share a dirty bit, which is set if any of them was dirty.
+ */
+static void
+promote_hugepage(pt_entry_t* pte, vaddr_t key)
+{
+  size_t index = key & (hugepage_pages - 1);
+  pt_entry_t* run = pte - index;
+  bool dirty = false;
+  for (size_t i = 0; i < hugepage_pages; i++) {
+    dirty |= (pte_flags(&run[i]) & PAGE_DIRTY) != 0;
+  }
+  for (size_t i = 0; i < hugepage_pages; i++) {
+    unsigned int flags = pte_flags(&run[i]);
+    if (dirty && !(flags & PAGE_DIRTY)) {
+      mark_dirty(&run[i]);
+      flags = pte_flags(&run[i]) | PAGE_SHARED_DIRTY;
+    }
+    pte_set_flags(&run[i], flags | PAGE_HUGE);
+    if (tlb_enabled) {
+      tlb_invalidate(key - index + i);
+    }
+  }
+  hugepage_stats.promotions++;
+}
+
+// Pages of a readahead window, from allocation until they are read
+struct readahead_page
+{
+  pt_entry_t* pte;
+  unsigned int frame;
+  off_t offset;
+};
+
+static _Thread_local struct readahead_page ra_window[READAHEAD_MAX_PAGES];
+
+static int
+compare_offsets(const void* a, const void* b)
+{
+  off_t x = ((const struct readahead_page*)a)->offset;
+  off_t y = ((const struct readahead_page*)b)->offset;
+  return (x > y) - (x < y);
+}
+
+/*
+ * Before the fault of the page (pte, key) is handled: if the fault continues
+ * a sequential or strided stream, brings in the pages on swap in the next
+ * window of the stream. Every page gets its frame first; then runs of pages
+ * in consecutive swap slots are read with a single swap read each.
+ */
+static void
+read_ahead(pt_entry_t* pte, vaddr_t key)
+{
+  long stride = readahead_fault(key);
+  if (stride == 0) {
+    return;
+  }
+  long index = key & (PTRS_PER_PT - 1);
+  long window = readahead_pages < memsize / 2 ? readahead_pages : memsize / 2;
+  long last = index;
+  size_t n = 0;
+  for (long i = 1; i <= window; i++) {
+    long j = index + i * stride;
+    if (j < 0 || j >= PTRS_PER_PT) {
+      break;
+    }
+    last = j;
+    pt_entry_t* p = pte + (j - index);
+    if ((pte_flags(p) & (PAGE_VALID | PAGE_ONSWAP)) != PAGE_ONSWAP) {
+      continue;
+    }
+    int frame = allocate_frame(p, key + (j - index));
+    pte_set_flags(p, PAGE_VALID | PAGE_PREFETCHED | PAGE_READAHEAD);
+    prefetching = true;
+    ref_func(frame);
+    prefetching = false;
+    ra_window[n].pte = p;
+    ra_window[n].frame = frame;
+    n++;
+  }
+  if (n == 0) {
+    return;
+  }
+  readahead_skip(key, last);
+  readahead_stats.windows++;
+
+  // Window pages evicted while later ones got frames were clean, so their
+  // frames were not written out; they are simply not read
+  size_t kept = 0;
+  for (size_t k = 0; k < n; k++) {
+    pt_entry_t* p = ra_window[k].pte;
+    if ((pte_flags(p) & PAGE_READAHEAD) && pte_frame(p) == ra_window[k].frame) {
+      ra_window[k].offset = pte_swap_offset(p);
+      ra_window[kept++] = ra_window[k];
+    }
+  }
+  readahead_stats.pages += n;
+  qsort(ra_window, kept, sizeof(ra_window[0]), compare_offsets);
+  unsigned int frames[READAHEAD_MAX_PAGES];
+  for (size_t k = 0; k < kept;) {
+    size_t len = 0;
+    do {
+      frames[len] = ra_window[k + len].frame;
+      len++;
+    } while (k + len < kept && ra_window[k + len].offset ==
+                                 ra_window[k].offset + (off_t)len * SIMPAGESIZE);
+    readahead_stats.reads++;
+    if (swap_pagein_run(frames, len, ra_window[k].offset) != 0) {
+      // Read the run page by page, so a page is never left resident with
+      // whatever its frame held before
+      for (size_t i = 0; i < len; i++) {
+        if (swap_pagein(frames[i], ra_window[k + i].offset) != 0) {
+          fprintf(stderr, "read_ahead: could not read page from swap\n");
+          exit(1);
+        }
+      }
+      readahead_stats.reads += len;
+    }
+    k += len;
+  }
+}
+
+/* Looks up the page key in the TLB, first as a page of a huge page. */
+static pt_entry_t*
+tlb_lookup_page(vaddr_t key)
+{
+  if (hugepage_enabled) {
+    pt_entry_t* run = tlb_lookup(hugepage_tlb_key(key));
+    if (run != NULL) {
+      return run + (key & (hugepage_pages - 1));
+    }
+  }
+  return tlb_lookup(key);
+}
+
+/*
+ * Locate the physical frame number for the given vaddr using the page table
+ * of process pid.
  *
  * If the page table entry is invalid and not on swap, then this is the first
  * reference to the page and a (simulated) physical frame should be allocated
@@ -138,31 +485,55 @@ init_frame(int frame)
  * this function.
  */
 unsigned char*
-find_physpage(vaddr_t vaddr, char type)
+find_physpage(unsigned short pid, vaddr_t vaddr, char type)
 {
   int frame = -1; // Frame used to hold vaddr
-  int vpn_index = ((vaddr & PAGE_MASK) >> PAGE_SHIFT);
-  assert (vpn_index < (int)g_pt_entry_size);
+  vaddr_t key = PAGE_KEY(pid, vaddr);
+  pt_entry_t* pte = tlb_enabled ? tlb_lookup_page(key) : NULL;
+  bool tlb_miss = pte == NULL;
+  if (tlb_miss) {
+    pte = lookup_pte(pid, vaddr);
+    walk_count++;
+  } else {
+    tlb_hit_count++;
+  }
   ref_count++;
-  if (g_pt_entry[vpn_index].flag == 0){
-   frame = allocate_frame(&g_pt_entry[vpn_index]);
+  struct proc_stats* stats = &proc_stats[pid];
+  unsigned int flags = pte_flags(pte);
+  bool fault = !(flags & PAGE_VALID);
+  if (fault && hugepage_enabled) {
+    collapse_hugepage(pte, key);
+  }
+  if (fault && readahead_enabled) {
+    read_ahead(pte, key);
+  }
+  if (flags == 0){
+   frame = allocate_frame(pte, key);
    init_frame(frame);
-   g_pt_entry[vpn_index].flag = PAGE_VALID|PAGE_REF|PAGE_DIRTY;
-   g_pt_entry[vpn_index].frame = frame;
+   pte_set_flags(pte, PAGE_VALID|PAGE_REF|PAGE_DIRTY);
    miss_count++;
-  } else if(g_pt_entry[vpn_index].flag&PAGE_VALID) {
+   stats->miss_count++;
+  } else if(flags&PAGE_VALID) {
     hit_count++;
-    frame = g_pt_entry[vpn_index].frame;
+    stats->hit_count++;
+    frame = pte_frame(pte);
+    if (flags & PAGE_READAHEAD) {
+      readahead_stats.used++;
+    } else if (flags & PAGE_PREFETCHED) {
+      hugepage_stats.faults_avoided++;
+    }
+    pte_set_flags(pte, flags & ~(PAGE_PREFETCHED | PAGE_READAHEAD));
     if(type == 'S' || type == 'M'){
-      g_pt_entry[vpn_index].flag = g_pt_entry[vpn_index].flag|PAGE_DIRTY;
+      write_page(pte, key);
     }
-  } else if(g_pt_entry[vpn_index].flag&PAGE_ONSWAP){
+  } else if(flags&PAGE_ONSWAP){
     miss_count++;
-    frame = allocate_frame(&g_pt_entry[vpn_index]);
-    g_pt_entry[vpn_index].flag = PAGE_VALID|PAGE_REF;
-    g_pt_entry[vpn_index].frame = frame;
-     if(type == 'S' || type == 'M'){
-      g_pt_entry[vpn_index].flag = g_pt_entry[vpn_index].flag|PAGE_DIRTY;
+    stats->miss_count++;
+    frame = allocate_frame(pte, key);
+    swap_pagein(frame, pte_swap_offset(pte));
+    pte_set_flags(pte, PAGE_VALID|PAGE_REF);
+    if(type == 'S' || type == 'M'){
+      write_page(pte, key);
     }
   } else {
     printf("Can not get here\n");
@@ -183,37 +554,125 @@ find_physpage(vaddr_t vaddr, char type)
 
   // Call replacement algorithm's ref_func for this page.
   assert(frame != -1);
+  if (fault && hugepage_enabled && !(pte_flags(pte) & PAGE_HUGE) &&
+      hugepage_resident(key) == hugepage_pages) {
+    promote_hugepage(pte, key);
+  }
   ref_func(frame);
+  if (tlb_enabled && tlb_miss) {
+    if (pte_flags(pte) & PAGE_HUGE) {
+      tlb_insert(hugepage_tlb_key(key),
+                 pte - (key & (hugepage_pages - 1)));
+    } else {
+      tlb_insert(key, pte);
+    }
+  }
+  if (timeseries_enabled) {
+    timeseries_ref(key, memsize - num_free_frames);
+  }
 
   // Return pointer into (simulated) physical memory at start of frame
   return &physmem[frame * SIMPAGESIZE];
 }
 
+/*
+ * Prints every page table entry that has been used, indexed by VPN, for
+ * one process.
+ */
+static void
+print_process_pagetable(const pdpt_entry_t* pdpt)
+{
+  for (size_t i = 0; i < PTRS_PER_PDPT; i++) {
+    if (!(pdpt[i].pdp & PAGE_VALID))
+      continue;
+    pd_entry_t* pd = (pd_entry_t*)(pdpt[i].pdp & ~(uintptr_t)PAGE_VALID);
+    for (size_t j = 0; j < PTRS_PER_PD; j++) {
+      if (!(pd[j].pde & PAGE_VALID))
+        continue;
+      pt_entry_t* pt = (pt_entry_t*)(pd[j].pde & ~(uintptr_t)PAGE_VALID);
+      for (size_t k = 0; k < PTRS_PER_PT; k++) {
+        unsigned int flags = pte_flags(&pt[k]);
+        if (flags == 0)
+          continue;
+        unsigned long vpn = (i << (PDPT_SHIFT - PT_SHIFT)) |
+                            (j << (PD_SHIFT - PT_SHIFT)) | k;
+        int ref = get_referenced(&pt[k]);
+        if(flags&PAGE_ONSWAP)
+          printf("pte[%#lx] in mem-frame = %u  pte[%#lx].ref  = %d onswap\n",vpn,pte_frame(&pt[k]),vpn,ref);
+        else
+          printf("pte[%#lx] in mem-frame = %u  pte[%#lx].ref  = %d \n",vpn,pte_frame(&pt[k]),vpn,ref);
+      }
+    }
+  }
+}
+
+/* Prints the page table of each process, preceded by its pid if several. */
 void
 print_pagetable(void)
 {
-  for(size_t i = 0;i<g_pt_entry_size;i++) {
-    if(g_pt_entry[i].flag != 0) {
-      if(g_pt_entry[i].flag&PAGE_ONSWAP)
-        printf("g_pt_entry[%d] in mem-frame = %d  g_pt_entry[%d].ref  = %d onswap\n",(unsigned int)i,(unsigned int)g_pt_entry[i].frame,(unsigned int)i,(unsigned int)g_pt_entry[i].ref);
-      else 
-        printf("g_pt_entry[%d] in mem-frame = %d  g_pt_entry[%d].ref  = %d \n",(unsigned int)i,(unsigned int)g_pt_entry[i].frame,(unsigned int)i,(unsigned int)g_pt_entry[i].ref);
-    } 
+  for (size_t pid = 0; pid < num_procs; pid++) {
+    if (pdpts[pid] == NULL)
+      continue;
+    if (num_procs > 1)
+      printf("pid %zu:\n", pid);
+    print_process_pagetable(pdpts[pid]);
+  }
+}
+
+/* Frees the page directories and page tables of one process. */
+static void
+free_process_pagetable(pdpt_entry_t* pdpt)
+{
+  for (size_t i = 0; i < PTRS_PER_PDPT; i++) {
+    if (!(pdpt[i].pdp & PAGE_VALID))
+      continue;
+    pd_entry_t* pd = (pd_entry_t*)(pdpt[i].pdp & ~(uintptr_t)PAGE_VALID);
+    for (size_t j = 0; j < PTRS_PER_PD; j++) {
+      if (pd[j].pde & PAGE_VALID)
+        free((pt_entry_t*)(pd[j].pde & ~(uintptr_t)PAGE_VALID));
+    }
+    free(pd);
   }
+  free(pdpt);
 }
 
+/* Frees every page directory and page table allocated by lookup_pte. */
 void
 free_pagetable(void)
 {
-  if(g_pt_entry != NULL)
-    free(g_pt_entry);
+  for (size_t pid = 0; pid < num_procs; pid++) {
+    if (pdpts[pid] != NULL)
+      free_process_pagetable(pdpts[pid]);
+  }
+  free(pdpts);
+  free(proc_stats);
+  pdpts = NULL;
+  proc_stats = NULL;
+  num_procs = 0;
+  free(free_frames);
+  free_frames = NULL;
+  num_free_frames = 0;
+  tlb_destroy();
+  hugepage_destroy();
+  readahead_destroy();
 }
 
+bool is_valid(struct pt_entry_s* pte)
+{
+  return (pte_flags(pte) & PAGE_VALID) != 0;
+}
+bool is_dirty(struct pt_entry_s* pte)
+{
+  return (pte_flags(pte) & PAGE_DIRTY) != 0;
+}
 bool get_referenced(struct pt_entry_s* pte)
 {
-  return pte->ref;
+  return (pte_flags(pte) & PAGE_REF) != 0;
 }
 void set_referenced(struct pt_entry_s* pte, bool val)
 {
-  pte->ref = val;
+  if (val)
+    pte->bits |= PAGE_REF;
+  else
+    pte->bits &= ~(uint64_t)PAGE_REF;
 }
\ No newline at end of file
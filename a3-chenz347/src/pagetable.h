@@ -1,11 +1,15 @@
 #ifndef CSC369_PAGETABLE_H
 #define CSC369_PAGETABLE_H
 
+#include <assert.h>
 #include <stdbool.h>
 #include <stddef.h>
 #include <stdint.h>
 #include <sys/types.h>
 
+#include "pagetable_generic.h"
+#include "sim.h"
+
 // User-level virtual addresses on a 64-bit Linux system are 48 bits in our
 // traces, and the page size is 4096 (12 bits). We split the remaining 36 bits
 // evenly into 3 parts, using 12 bits for each:
@@ -21,6 +25,10 @@
 #define PAGE_DIRTY 0x2  // Dirty bit in pte, set if page has been modified
 #define PAGE_REF 0x4    // Reference bit in pte, set if page has been referenced
 #define PAGE_ONSWAP 0x8 // Set if page has been evicted to swap
+#define PAGE_HUGE 0x10  // Set if page is part of a huge page (see hugepage.h)
+#define PAGE_PREFETCHED 0x20   // Brought in unreferenced, not referenced since
+#define PAGE_SHARED_DIRTY 0x40 // Dirty only through its huge page's dirty bit
+#define PAGE_READAHEAD 0x80    // Prefetched by swap readahead (see readahead.h)
 
 #define PT_SHIFT 12    // Leaves top 36 bits of vaddr
 #define PD_SHIFT 24   // Leaves top 24 bits of vaddr
@@ -51,13 +59,71 @@ typedef struct
   uintptr_t pde;
 } pd_entry_t;
 
-// Page table entry (3rd-level)
+// Page table entry (3rd-level), packed into a single 64-bit word:
+//
+// 63                    36 35                     8 7           0
+// |-----------------------|------------------------|-------------|
+//    swap slot + 1 (0=none)        frame number          flags
+//
+// The flags are the PAGE_* bits above. A page that was swapped in and not
+// modified keeps its swap slot while resident, so the frame and the slot
+// each get their own field and a clean eviction needs no write.
 typedef struct pt_entry_s
 {
-  bool ref;          
-  unsigned int frame; // if valid bit == 1, physical frame holding vpage
-  unsigned int flag;  
-  off_t swap_offset;  // offset in swap file of vpage, if any
+  uint64_t bits;
 } pt_entry_t;
 
+#define PTE_FLAG_MASK 0xffULL
+#define PTE_FRAME_SHIFT 8
+#define PTE_FRAME_BITS 28
+#define PTE_FRAME_MASK (((1ULL << PTE_FRAME_BITS) - 1) << PTE_FRAME_SHIFT)
+#define PTE_SLOT_SHIFT 36
+#define PTE_SLOT_BITS 28
+#define PTE_SLOT_MASK (((1ULL << PTE_SLOT_BITS) - 1) << PTE_SLOT_SHIFT)
+
+static inline unsigned int
+pte_flags(const pt_entry_t* pte)
+{
+  return (unsigned int)(pte->bits & PTE_FLAG_MASK);
+}
+
+static inline void
+pte_set_flags(pt_entry_t* pte, unsigned int flags)
+{
+  pte->bits = (pte->bits & ~PTE_FLAG_MASK) | (flags & PTE_FLAG_MASK);
+}
+
+static inline unsigned int
+pte_frame(const pt_entry_t* pte)
+{
+  return (unsigned int)((pte->bits & PTE_FRAME_MASK) >> PTE_FRAME_SHIFT);
+}
+
+static inline void
+pte_set_frame(pt_entry_t* pte, unsigned int frame)
+{
+  assert(frame < (1U << PTE_FRAME_BITS));
+  pte->bits = (pte->bits & ~PTE_FRAME_MASK) |
+              (((uint64_t)frame << PTE_FRAME_SHIFT) & PTE_FRAME_MASK);
+}
+
+// Swap positions are stored as slot indices and converted to and from the
+// byte offsets used by swap.c.
+static inline off_t
+pte_swap_offset(const pt_entry_t* pte)
+{
+  uint64_t slot = (pte->bits & PTE_SLOT_MASK) >> PTE_SLOT_SHIFT;
+  return slot == 0 ? INVALID_SWAP : (off_t)((slot - 1) * SIMPAGESIZE);
+}
+
+static inline void
+pte_set_swap_offset(pt_entry_t* pte, off_t offset)
+{
+  uint64_t slot =
+    offset == INVALID_SWAP ? 0 : (uint64_t)offset / SIMPAGESIZE + 1;
+  assert(slot < (1ULL << PTE_SLOT_BITS));
+  pte->bits = (pte->bits & ~PTE_SLOT_MASK) |
+              ((slot << PTE_SLOT_SHIFT) & PTE_SLOT_MASK);
+}
+
 #endif /* CSC369_PAGETABLE_H */
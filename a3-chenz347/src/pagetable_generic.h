@@ -5,7 +5,6 @@
 #include <stddef.h>
 #include <stdint.h>
 #include <sys/types.h>
-#include "list.h"
 
 // Everything in this file should be independent of the actual page table
 // format. All definitions that are specific to a particular page table format
@@ -20,6 +19,12 @@
 
 typedef unsigned long vaddr_t;
 
+// Every process has its own address space, so a virtual page is identified
+// by its page key: the owning process id above the virtual page number.
+#define PAGE_KEY(pid, vaddr)                                                  \
+  (((vaddr_t)(pid) << NUM_VPN_BITS) | ((vaddr) >> PAGE_SHIFT))
+#define PAGE_KEY_PID(key) ((unsigned short)((key) >> NUM_VPN_BITS))
+
 // Page table entry - actual definition will go in pagetable.h or pagetable.c
 struct pt_entry_s;
 
@@ -31,41 +36,25 @@ struct pt_entry_s;
  */
 struct frame
 {
-  bool in_use;            // true if frame is allocated, false if frame is free
   struct pt_entry_s* pte; // Pointer back to pagetable entry (pte) for page
                           // stored in this frame
-  struct frame* next;
-  struct frame* prev;
-  struct list_entry double_list;
-  int    frame_id;
+  vaddr_t vpn;            // Page key (see PAGE_KEY) of the page in this frame
 };
 
-extern struct frame* coremap;
+// Anything a replacement policy keeps per frame (list links, reference
+// bits, ...) lives in arrays of its own, allocated in its init function;
+// see coremap.h.
 
-static inline void
-frame_list_init_head(struct frame* head)
-{
-  head->next = head;
-  head->prev = head;
-}
+extern _Thread_local struct frame* coremap;
 
-static inline void
-frame_list_insert(struct frame* entry, struct frame* prev, struct frame* next)
-{
-  next->prev = entry;
-  entry->next = next;
-  entry->prev = prev;
-  prev->next = entry;
-}
-
-static inline void
-frame_list_delete(struct frame* entry)
-{
-  entry->next->prev = entry->prev;
-  entry->prev->next = entry->next;
-  entry->next = NULL;
-  entry->prev = NULL;
-}
+// Page table entry of the page being brought into memory while evict_func
+// runs, for policies that remember evicted pages (see ghost.h).
+extern _Thread_local struct pt_entry_s* fault_pte;
+
+// True while ref_func is called for a page brought into memory without being
+// referenced (to complete a huge page, or read ahead from swap), rather than
+// for a reference.
+extern _Thread_local bool prefetching;
 
 void
 init_pagetable(void);
@@ -74,7 +63,7 @@ print_pagetable(void);
 void
 free_pagetable(void);
 unsigned char*
-find_physpage(vaddr_t vaddr, char type);
+find_physpage(unsigned short pid, vaddr_t vaddr, char type);
 bool
 is_valid(struct pt_entry_s* pte);
 bool
@@ -98,6 +87,14 @@ void
 mru_init(void);
 void
 opt_init(void);
+void
+arc_init(void);
+void
+car_init(void);
+void
+lirs_init(void);
+void
+clockpro_init(void);
 
 // These may not need to do anything for some algorithms
 void
@@ -112,6 +109,14 @@ void
 mru_cleanup(void);
 void
 opt_cleanup(void);
+void
+arc_cleanup(void);
+void
+car_cleanup(void);
+void
+lirs_cleanup(void);
+void
+clockpro_cleanup(void);
 
 // These may not need to do anything for some algorithms
 void
@@ -126,6 +131,14 @@ void
 mru_ref(int frame);
 void
 opt_ref(int frame);
+void
+arc_ref(int frame);
+void
+car_ref(int frame);
+void
+lirs_ref(int frame);
+void
+clockpro_ref(int frame);
 
 int
 rand_evict(void);
@@ -139,5 +152,13 @@ int
 mru_evict(void);
 int
 opt_evict(void);
+int
+arc_evict(void);
+int
+car_evict(void);
+int
+lirs_evict(void);
+int
+clockpro_evict(void);
 
 #endif /* CSC369_PAGETABLE_GENERIC_H */
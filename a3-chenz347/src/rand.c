@@ -1,7 +1,15 @@
+#include <stdint.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include "sim.h"
 
+// Each instance has its own generator so that concurrent simulations do not
+// disturb each other's sequence. It is seeded like the default random()
+// state, so results match a run that calls random() directly.
+static _Thread_local struct random_data rand_data;
+static _Thread_local char rand_state[128];
+
 /* Page to evict is chosen using the RAND algorithm.
  * Returns the page frame number (which is also the index in the coremap)
  * for the page that is to be evicted.
@@ -9,8 +17,10 @@
 int
 rand_evict(void)
 {
-  // NOTE: We keep the default seed (don't call srandom) for repeatable results
-  return random() % memsize;
+  // NOTE: We keep the default seed (1) for repeatable results
+  int32_t r;
+  random_r(&rand_data, &r);
+  return r % memsize;
 }
 
 /* This function is called on each access to a page to update any information
@@ -26,7 +36,10 @@ rand_ref(int frame)
 /* Initialize any data structures needed for this replacement algorithm. */
 void
 rand_init(void)
-{}
+{
+  memset(&rand_data, 0, sizeof(rand_data));
+  initstate_r(1, rand_state, sizeof(rand_state), &rand_data);
+}
 
 /* Cleanup any data structures created in rand_init(). */
 void
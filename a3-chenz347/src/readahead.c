@@ -0,0 +1,95 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "pagetable.h"
+#include "readahead.h"
+#include "vpnmap.h"
+
+#define STREAM_SHIFT (PD_SHIFT - PT_SHIFT) // one stream per page table
+
+bool readahead_enabled = false;
+size_t readahead_pages;
+
+// Stream of each page table with faults, packed as the page table index
+// of the last fault (or of the end of the last window) in the low 32 bits
+// and the stride from the fault before it in the high 32 bits.
+static _Thread_local struct vpnmap streams;
+
+static inline uint64_t
+stream_pack(long index, long stride)
+{
+  return (uint32_t)(int32_t)index |
+         ((uint64_t)(uint32_t)(int32_t)stride << 32);
+}
+
+/*
+ * Enables readahead of up to spec pages (at most READAHEAD_MAX_PAGES) per
+ * fault. Returns 0 on success, -1 if spec is invalid.
+ */
+int
+readahead_configure(const char* spec)
+{
+  char* end;
+  unsigned long pages = strtoul(spec, &end, 10);
+  if (end == spec || *end != '\0' || pages == 0 ||
+      pages > READAHEAD_MAX_PAGES) {
+    return -1;
+  }
+  readahead_pages = pages;
+  readahead_enabled = true;
+  return 0;
+}
+
+void
+readahead_init(void)
+{
+  if (readahead_enabled) {
+    vpnmap_init(&streams);
+  }
+}
+
+void
+readahead_destroy(void)
+{
+  if (readahead_enabled) {
+    vpnmap_destroy(&streams);
+  }
+}
+
+/*
+ * Records a fault on the page with the given page key. Returns the stride
+ * to read ahead along if it continues the stride of its stream, else 0.
+ */
+int
+readahead_fault(vaddr_t key)
+{
+  long index = key & (PTRS_PER_PT - 1);
+  bool first;
+  uint64_t* stream = vpnmap_lookup(&streams, key >> STREAM_SHIFT, &first);
+  long stride = 0;
+  if (!first) {
+    long last = (int32_t)(uint32_t)*stream;
+    long last_stride = (int32_t)(uint32_t)(*stream >> 32);
+    stride = index - last;
+    if (stride != 0 && stride == last_stride) {
+      *stream = stream_pack(index, stride);
+      return stride;
+    }
+  }
+  *stream = stream_pack(index, stride);
+  return 0;
+}
+
+/*
+ * Moves the stream of the page with the given page key past a window that
+ * was read ahead up to page table index, so that the next fault of the
+ * stream, just after the window, keeps its stride.
+ */
+void
+readahead_skip(vaddr_t key, long index)
+{
+  uint64_t* stream = vpnmap_find(&streams, key >> STREAM_SHIFT);
+  long stride = (int32_t)(uint32_t)(*stream >> 32);
+  *stream = stream_pack(index, stride);
+}
@@ -0,0 +1,33 @@
+#ifndef CSC369_READAHEAD_H
+#define CSC369_READAHEAD_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "pagetable_generic.h"
+
+// Optional swap readahead. Faults are tracked per page table (4096 pages of
+// one process): once two faults in a row there are the same stride apart,
+// a fault also reads the next pages along that stride that are on swap,
+// up to a window of readahead_pages, in as few swap reads as their slots
+// allow. The stream then continues from the end of the window. Each
+// instance tracks its own streams.
+
+#define READAHEAD_MAX_PAGES 256
+
+extern bool readahead_enabled;
+extern size_t readahead_pages;
+
+int
+readahead_configure(const char* spec);
+void
+readahead_init(void);
+void
+readahead_destroy(void);
+
+int
+readahead_fault(vaddr_t key);
+void
+readahead_skip(vaddr_t key, long index);
+
+#endif /* CSC369_READAHEAD_H */
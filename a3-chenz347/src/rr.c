@@ -1,5 +1,7 @@
 #include "sim.h"
 
+static _Thread_local size_t rr_next = 0;
+
 /* Page to evict is chosen using the Round Robin algorithm.
  * Since our simulated traces have only one process that never frees
  * memory regions, this is equivalent to FIFO.
@@ -9,9 +11,8 @@
 int
 rr_evict(void)
 {
-  static int i = 0;
-  int victim = i;
-  i = (i + 1) % memsize;
+  int victim = rr_next;
+  rr_next = (rr_next + 1) % memsize;
   return victim;
 }
 
@@ -28,7 +29,9 @@ rr_ref(int frame)
 /* Initialize any data structures needed for this replacement algorithm. */
 void
 rr_init(void)
-{}
+{
+  rr_next = 0;
+}
 
 /* Cleanup any data structures created in rr_init(). */
 void
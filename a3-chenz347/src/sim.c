@@ -1,7 +1,13 @@
 #include "sim.h"
+#include "engine.h"
+#include "hugepage.h"
+#include "readahead.h"
 #include "pagetable_generic.h"
 #include "swap.h"
 #include "timer.h"
+#include "timeseries.h"
+#include "tlb.h"
+#include "trace.h"
 #include <assert.h>
 #include <err.h>
 #include <getopt.h>
@@ -15,11 +21,8 @@
 #include <unistd.h>
 
 // Define global variables declared in sim.h
-size_t memsize = 0;
 bool debug = false;
-unsigned char* physmem = NULL;
-struct frame* coremap = NULL;
-char* tracefile = NULL;
+_Thread_local char* tracefile = NULL;
 
 /*
  * Add up all memory in simulator process's maps. Subtract baseline usage for
@@ -71,212 +74,484 @@ get_bytes_used(struct mallinfo* start_mallinfo)
   return all_bytes;
 }
 
-/* Each eviction algorithm is represented by a structure with its name
- * and three functions.
- */
-struct functions
+static void
+replay_trace(trace_t* t)
 {
-  const char* name;      // String name of eviction algorithm
-  void (*init)(void);    // Initialize any data needed by alg
-  void (*cleanup)(void); // Cleanup any data initialized in init()
-  void (*ref)(int);      // Called on each reference
-  int (*evict)(void);    // Called to choose victim for eviction
-};
+  struct trace_ref ref;
+  while (trace_next(t, &ref)) {
+    if (debug) {
+      printf("%c %lx %hhu\n", ref.type, ref.vaddr, ref.val);
+    }
 
-/* The algs array gives us a mapping between the name of an eviction
- * algorithm as given in a command line argument, and the function to
- * call to select the victim page.
- */
-static struct functions algs[] = {
-  { "rand", rand_init, rand_cleanup, rand_ref, rand_evict },
-  { "rr", rr_init, rr_cleanup, rr_ref, rr_evict },
-  { "clock", clock_init, clock_cleanup, clock_ref, clock_evict },
-  { "lru", lru_init, lru_cleanup, lru_ref, lru_evict },
-};
-static size_t num_algs = sizeof(algs) / sizeof(algs[0]);
+    sim_access(&ref, t->linenum);
+  }
+}
 
-static void (*init_func)() = NULL;
-static void (*cleanup_func)() = NULL;
+#define MAX_ALGS 16
+#define MAX_PROCS 64
 
-void (*ref_func)(int) = NULL;
-int (*evict_func)() = NULL;
+/* Prints one row per instance of a multi-algorithm run. */
+static void
+print_combined_report(const struct sim_job* jobs, size_t njobs)
+{
+  printf("\n");
+  printf("%-8s %12s %12s %12s %12s %9s %9s",
+         "Alg",
+         "Hits",
+         "Misses",
+         "Clean ev.",
+         "Dirty ev.",
+         "Hit rate",
+         "Time");
+  if (tlb_enabled) {
+    printf(" %9s %12s", "TLB hit", "Walks");
+  }
+  if (hugepage_enabled) {
+    printf(" %9s %9s %12s", "Promoted", "Splits", "Avoided");
+  }
+  if (readahead_enabled) {
+    printf(" %12s %12s", "Read ahead", "RA used");
+  }
+  printf("\n");
+  for (size_t j = 0; j < njobs; j++) {
+    const struct sim_result* r = &jobs[j].result;
+    printf("%-8s %12zu %12zu %12zu %12zu %9.4f %9.4f",
+           sim_alg_name(jobs[j].alg),
+           r->hit_count,
+           r->miss_count,
+           r->evict_clean_count,
+           r->evict_dirty_count,
+           ((double)r->hit_count / r->ref_count) * 100.0,
+           r->time);
+    if (tlb_enabled) {
+      printf(" %9.4f %12zu",
+             ((double)r->tlb_hit_count / r->ref_count) * 100.0,
+             r->walk_count);
+    }
+    if (hugepage_enabled) {
+      printf(" %9zu %9zu %12zu",
+             r->huge.promotions,
+             r->huge.splits,
+             r->huge.faults_avoided);
+    }
+    if (readahead_enabled) {
+      printf(" %12zu %12zu", r->readahead.pages, r->readahead.used);
+    }
+    printf("\n");
+  }
+  printf("Total references: %zu\n", jobs[0].result.ref_count);
+}
 
-/* An actual memory access based on the vaddr from the trace file.
- *
- * The find_physpage() function is called to translate the virtual address
- * to a (simulated) physical address -- that is, a pointer to the right
- * location in physmem array. The find_physpage() function is responsible for
- * everything to do with memory management - including translation using the
- * pagetable, allocating a frame of (simulated) physical memory (if needed),
- * evicting an existing page from the frame (if needed) and reading the page
- * in from swap (if needed).
- *
- * We then check that the memory has the expected content (just a copy of the
- * virtual address) and, in case of a write reference, increment the version
- * counter.
+/*
+ * Prints what huge pages did to a run: promotions, the faults they saved
+ * (populated pages referenced before eviction), the populated pages that
+ * were never used (internal fragmentation) and the swap writes of pages
+ * that were never used or only dirty through their huge page.
  */
 static void
-access_mem(char type, vaddr_t vaddr, unsigned char val, size_t linenum)
+print_hugepage_report(const struct sim_result* r)
 {
-  unsigned char* pgptr;
-  unsigned char* memptr;
-  unsigned offset = vaddr % PAGE_SIZE;
+  const struct hugepage_stats* h = &r->huge;
+  size_t unused = h->populated - h->faults_avoided;
+  size_t huge_frames = h->promotions * hugepage_pages;
+  size_t needed_writes = r->evict_dirty_count - h->extra_writes;
+  printf("Huge page promotions: %zu\n", h->promotions);
+  printf("Huge page splits: %zu\n", h->splits);
+  printf("Pages populated by promotion: %zu\n", h->populated);
+  printf("Faults avoided: %zu\n", h->faults_avoided);
+  printf("Fault reduction: %.4f\n",
+         h->faults_avoided
+           ? ((double)h->faults_avoided / (r->miss_count + h->faults_avoided)) *
+               100.0
+           : 0.0);
+  printf("Populated pages never referenced: %zu\n", unused);
+  printf("Internal fragmentation: %.4f\n",
+         huge_frames ? ((double)unused / huge_frames) * 100.0 : 0.0);
+  printf("Dirty evictions due to huge pages: %zu\n", h->extra_writes);
+  printf("Swap amplification: %.4f\n",
+         needed_writes ? (double)r->evict_dirty_count / needed_writes : 1.0);
+}
 
-  pgptr = find_physpage(vaddr, type);
-  memptr = pgptr + offset;
+/*
+ * Prints what swap readahead did to a run: the pages it read and the share
+ * of them referenced before eviction (its accuracy), the faults that saved,
+ * and how many swap reads it took to bring them in.
+ */
+static void
+print_readahead_report(const struct sim_result* r)
+{
+  const struct readahead_stats* ra = &r->readahead;
+  printf("Readahead windows: %zu\n", ra->windows);
+  printf("Pages read ahead: %zu\n", ra->pages);
+  printf("Faults avoided by readahead: %zu\n", ra->used);
+  printf("Readahead accuracy: %.4f\n",
+         ra->pages ? ((double)ra->used / ra->pages) * 100.0 : 0.0);
+  printf("Readahead swap reads: %zu\n", ra->reads);
+  printf("Pages per readahead read: %.4f\n",
+         ra->reads ? (double)ra->pages / ra->reads : 0.0);
+}
 
-  if ((type == 'S') || (type == 'M')) {
-    // write access to page, update value in simulated memory
-    *memptr = val;
-  } else if ((type == 'L' || type == 'I')) {
-    if (*memptr != val) {
-      printf("ERROR at trace line %zu: vaddr has %hhu but should have %hhu\n",
-             linenum,
-             *memptr,
-             val);
+/*
+ * Prints one row per process and instance. With local replacement, quotas
+ * holds the frames of each process; otherwise it is NULL.
+ */
+static void
+print_process_report(const struct sim_job* jobs,
+                     size_t njobs,
+                     const size_t* quotas)
+{
+  printf("\n");
+  printf("%-8s %6s", "Alg", "PID");
+  if (quotas) {
+    printf(" %8s", "Frames");
+  }
+  printf(" %12s %12s %12s %9s\n", "Hits", "Misses", "Evicted", "Hit rate");
+  for (size_t j = 0; j < njobs; j++) {
+    const struct sim_result* r = &jobs[j].result;
+    for (size_t pid = 0; pid < r->num_procs; pid++) {
+      const struct proc_stats* s = &r->procs[pid];
+      size_t refs = s->hit_count + s->miss_count;
+      if (refs == 0) {
+        continue;
+      }
+      printf("%-8s %6zu", sim_alg_name(jobs[j].alg), pid);
+      if (quotas) {
+        printf(" %8zu", quotas[pid]);
+      }
+      printf(" %12zu %12zu %12zu %9.4f\n",
+             s->hit_count,
+             s->miss_count,
+             s->evict_count,
+             ((double)s->hit_count / refs) * 100.0);
     }
   }
 }
 
+/*
+ * Adds up the per-process instances of local replacement into one result
+ * per algorithm, so they can be reported like a global run.
+ */
 static void
-replay_trace(FILE* f)
+merge_local_jobs(const struct sim_job* jobs,
+                 size_t nprocs,
+                 struct sim_job* merged)
 {
-  char line[256];
-  size_t linenum = 0;
-  while (fgets(line, sizeof(line), f)) {
-    ++linenum;
-    if (line[0] == '=') {
-      continue;
+  struct sim_result* m = &merged->result;
+  memset(merged, 0, sizeof(*merged));
+  merged->alg = jobs[0].alg;
+  merged->pid = -1;
+  m->procs = calloc(nprocs, sizeof(struct proc_stats));
+  if (!m->procs) {
+    perror("sim");
+    exit(1);
+  }
+  m->num_procs = nprocs;
+  for (size_t pid = 0; pid < nprocs; pid++) {
+    const struct sim_result* r = &jobs[pid].result;
+    merged->memsize += jobs[pid].memsize;
+    m->hit_count += r->hit_count;
+    m->miss_count += r->miss_count;
+    m->ref_count += r->ref_count;
+    m->evict_clean_count += r->evict_clean_count;
+    m->evict_dirty_count += r->evict_dirty_count;
+    m->tlb_hit_count += r->tlb_hit_count;
+    m->walk_count += r->walk_count;
+    m->time += r->time;
+    m->huge.promotions += r->huge.promotions;
+    m->huge.splits += r->huge.splits;
+    m->huge.populated += r->huge.populated;
+    m->huge.faults_avoided += r->huge.faults_avoided;
+    m->huge.extra_writes += r->huge.extra_writes;
+    m->readahead.windows += r->readahead.windows;
+    m->readahead.pages += r->readahead.pages;
+    m->readahead.used += r->readahead.used;
+    m->readahead.reads += r->readahead.reads;
+    if (pid < r->num_procs) {
+      m->procs[pid] = r->procs[pid];
     }
+  }
+}
 
-    vaddr_t vaddr;
-    char type;
-    unsigned char val;
-    if (sscanf(line, "%c %zx %hhu", &type, &vaddr, &val) != 3) {
-      fprintf(stderr, "Invalid trace line %zu: %s\n", linenum, line);
-      exit(1);
-    }
-    if (type != 'I' && type != 'L' && type != 'S' && type != 'M') {
-      fprintf(stderr, "Invalid reftype, line %zu: %s\n", linenum, line);
-      exit(1);
-    }
-    if ((vaddr % PAGE_SIZE) > SIMPAGESIZE) {
-      fprintf(stderr,
-              "Invalid vaddr, offset must be in range of simulated page frame "
-              "size, line %zu: %s\n",
-              linenum,
-              line);
-      exit(1);
-    }
-    if (debug) {
-      printf("%c %lx %hhu\n", type, vaddr, val);
-    }
+/* Writes the samples of every instance and says where they went. */
+static int
+write_timeseries(const char* path,
+                 bool binary,
+                 const struct sim_job* jobs,
+                 size_t njobs)
+{
+  if (timeseries_write(path, binary, jobs, njobs) != 0) {
+    return -1;
+  }
+  size_t samples = 0;
+  for (size_t j = 0; j < njobs; j++) {
+    samples += jobs[j].result.series.count;
+  }
+  printf("Time series: %zu samples written to %s\n", samples, path);
+  return 0;
+}
 
-    access_mem(type, vaddr, val, linenum);
+/*
+ * Parses the frame quota of each process, in pid order. Returns how many
+ * there are, or 0 if one is invalid.
+ */
+static size_t
+parse_quotas(char* arg, size_t* quotas, size_t max_quotas)
+{
+  size_t n = 0;
+  char* saveptr = NULL;
+  for (char* s = strtok_r(arg, ",", &saveptr); s != NULL;
+       s = strtok_r(NULL, ",", &saveptr)) {
+    size_t quota = strtoul(s, NULL, 10);
+    if (quota == 0 || n == max_quotas) {
+      fprintf(stderr, "Error: invalid frame quota - %s\n", s);
+      return 0;
+    }
+    quotas[n++] = quota;
   }
+  return n;
 }
-extern size_t g_pt_entry_size;
+
 int
 main(int argc, char* argv[])
 {
+  size_t memory = 0;
   size_t swapsize = 0;
   char* replacement_alg = NULL;
   double starttime;
   double endtime;
   struct mallinfo start_mallinfo;
   unsigned long bytes_used;
+  size_t quotas[MAX_PROCS];
+  size_t nquotas = 0;
+  const char* series_path = NULL;
+  bool series_binary = false;
   const char* usage =
-    "USAGE: sim -f tracefile -m memorysize -s swapsize -a algorithm\n";
+    "USAGE: sim -f tracefile -m memorysize -s swapsize -a algorithm "
+    "[-S backend]\n"
+    "           [-T entries[:ways[:policy]]] [-H order[:threshold]]\n"
+    "           [-Q frames[,frames...]] [-R pages]\n"
+    "           [-P period[:window] -o file [-b]]\n"
+    "       (algorithm may be a comma-separated list, or \"all\")\n"
+    "       (backend is file (default), mem or mmap)\n"
+    "       (TLB policy is lru (default), fifo or rand)\n"
+    "       (-H maps runs of 2^order pages as huge pages, promoted once\n"
+    "        threshold of their pages are resident (default: all))\n"
+    "       (-Q gives process 0, 1, ... its own frames: local replacement)\n"
+    "       (-R reads up to pages ahead from swap on strided faults)\n"
+    "       (-P samples every period references into file, as CSV or, with\n"
+    "        -b, binary; window is that of the working set (default: "
+    "period))\n";
 
   int opt;
-  while ((opt = getopt(argc, argv, "f:m:a:s:")) != -1) {
+  while ((opt = getopt(argc, argv, "f:m:a:s:S:T:H:Q:R:P:o:b")) != -1) {
     switch (opt) {
       case 'f':
         tracefile = optarg;
         break;
       case 'm':
-        memsize = strtoul(optarg, NULL, 10);
+        memory = strtoul(optarg, NULL, 10);
         break;
       case 'a':
         replacement_alg = optarg;
         break;
       case 's':
         swapsize = strtoul(optarg, NULL, 10);
-        // g_pt_entry_size = swapsize;
+        break;
+      case 'S':
+        if (swap_set_backend(optarg) != 0) {
+          fprintf(stderr, "Error: invalid swap backend - %s\n", optarg);
+          return 1;
+        }
+        break;
+      case 'T':
+        if (tlb_configure(optarg) != 0) {
+          fprintf(stderr, "Error: invalid TLB configuration - %s\n", optarg);
+          return 1;
+        }
+        break;
+      case 'H':
+        if (hugepage_configure(optarg) != 0) {
+          fprintf(stderr,
+                  "Error: invalid huge page configuration - %s\n",
+                  optarg);
+          return 1;
+        }
+        break;
+      case 'R':
+        if (readahead_configure(optarg) != 0) {
+          fprintf(stderr, "Error: invalid readahead window - %s\n", optarg);
+          return 1;
+        }
+        break;
+      case 'P':
+        if (timeseries_configure(optarg) != 0) {
+          fprintf(stderr, "Error: invalid sampling period - %s\n", optarg);
+          return 1;
+        }
+        break;
+      case 'o':
+        series_path = optarg;
+        break;
+      case 'b':
+        series_binary = true;
+        break;
+      case 'Q':
+        if ((nquotas = parse_quotas(optarg, quotas, MAX_PROCS)) == 0) {
+          return 1;
+        }
         break;
       default:
         fprintf(stderr, "%s", usage);
         return 1;
     }
   }
-  if (!tracefile || !memsize || !swapsize || !replacement_alg) {
+  if (!tracefile || !memory || !swapsize || !replacement_alg ||
+      timeseries_enabled != (series_path != NULL)) {
     fprintf(stderr, "%s", usage);
     return 1;
   }
 
-  FILE* tfp = fopen(tracefile, "r");
-  if (!tfp) {
-    perror(tracefile);
+  int algs[MAX_ALGS];
+  size_t nalgs = sim_parse_algs(replacement_alg, algs, MAX_ALGS);
+  if (nalgs == 0) {
+    return 1;
+  }
+  size_t quota_total = 0;
+  for (size_t pid = 0; pid < nquotas; pid++) {
+    quota_total += quotas[pid];
+  }
+  if (quota_total > memory) {
+    fprintf(stderr,
+            "Error: frame quotas add up to %zu, more than the %zu frames\n",
+            quota_total,
+            memory);
     return 1;
   }
 
-  // Initialize main data structures for simulation.
-  // This happens before calling the replacement algorithm init function
-  // so that the init_func can refer to the coremap if needed.
-  // coremap = calloc(memsize, sizeof(struct frame));
-  // physmem = calloc(memsize, SIMPAGESIZE);
-  coremap = malloc(memsize * sizeof(struct frame));
-  physmem = malloc(memsize * SIMPAGESIZE);
-  swap_init(swapsize);
-
-  for (size_t i = 0; i < num_algs; ++i) {
-    if (strcmp(algs[i].name, replacement_alg) == 0) {
-      init_func = algs[i].init;
-      cleanup_func = algs[i].cleanup;
-      ref_func = algs[i].ref;
-      evict_func = algs[i].evict;
-      break;
+  // Local replacement runs every process as its own instance, with only
+  // its quota of frames to replace from
+  size_t nprocs = nquotas ? nquotas : 1;
+  size_t njobs = nalgs * nprocs;
+  struct sim_job* jobs = malloc(njobs * sizeof(struct sim_job));
+  if (!jobs) {
+    perror("sim");
+    return 1;
+  }
+  for (size_t a = 0; a < nalgs; a++) {
+    for (size_t p = 0; p < nprocs; p++) {
+      struct sim_job* job = &jobs[a * nprocs + p];
+      job->alg = algs[a];
+      job->memsize = nquotas ? quotas[p] : memory;
+      job->swapsize = swapsize;
+      job->pid = nquotas ? (int)p : -1;
     }
   }
-  if (!evict_func) {
-    fprintf(
-      stderr, "Error: invalid replacement algorithm - %s\n", replacement_alg);
+
+  trace_t trace;
+  if (trace_open(&trace, tracefile) != 0) {
     return 1;
   }
 
+  if (njobs > 1 || nquotas > 0) {
+    // Decode the trace once and replay it on one thread per instance
+    starttime = get_time();
+    size_t total = sim_run_jobs(&trace, jobs, njobs);
+    endtime = get_time();
+    trace_close(&trace);
+
+    struct sim_job* results = jobs;
+    if (nquotas > 0) {
+      results = malloc(nalgs * sizeof(struct sim_job));
+      if (!results) {
+        perror("sim");
+        return 1;
+      }
+      for (size_t a = 0; a < nalgs; a++) {
+        merge_local_jobs(&jobs[a * nprocs], nprocs, &results[a]);
+      }
+      if (results[0].result.ref_count != total) {
+        fprintf(stderr,
+                "Error: %zu references are from processes without a quota\n",
+                total - results[0].result.ref_count);
+        return 1;
+      }
+    }
+
+    print_combined_report(results, nalgs);
+    if (nquotas > 0 || results[0].result.num_procs > 1) {
+      print_process_report(results, nalgs, nquotas ? quotas : NULL);
+    }
+    printf("Time to run simulation: %f\n", endtime - starttime);
+    if (timeseries_enabled && write_timeseries(series_path, series_binary,
+                                               jobs, njobs) != 0) {
+      return 1;
+    }
+    for (size_t j = 0; j < njobs; j++) {
+      free(jobs[j].result.procs);
+      free(jobs[j].result.series.samples);
+    }
+    if (results != jobs) {
+      for (size_t a = 0; a < nalgs; a++) {
+        free(results[a].result.procs);
+      }
+      free(results);
+    }
+    free(jobs);
+    return 0;
+  }
+
+  struct sim_result result;
+  sim_instance_init(jobs[0].alg, memory, swapsize);
+
   start_mallinfo = mallinfo();
   starttime = get_time();
-  // Call pagetable and replacement algorithm's init_func before
-  // replaying trace.
-  init_pagetable();
-  init_func();
-  replay_trace(tfp);
-  //(void)replay_trace;
+  sim_instance_start();
+  replay_trace(&trace);
   endtime = get_time();
   bytes_used = get_bytes_used(&start_mallinfo);
 
   if (debug) {
     print_pagetable();
   }
-  cleanup_func();
-
-  // Cleanup data structures and remove temporary swapfile
-  free(coremap);
-  free(physmem);
-  swap_destroy();
-  free_pagetable();
+  sim_instance_finish(&result);
+  trace_close(&trace);
 
   printf("\n");
-  printf("Hit count: %zu\n", hit_count);
-  printf("Miss count: %zu\n", miss_count);
-  printf("Clean evictions: %zu\n", evict_clean_count);
-  printf("Dirty evictions: %zu\n", evict_dirty_count);
-  printf("Total references: %zu\n", ref_count);
-  printf("Hit rate: %.4f\n", ((double)hit_count / ref_count) * 100.0);
-  printf("Miss rate: %.4f\n", ((double)miss_count / ref_count) * 100.0);
+  printf("Hit count: %zu\n", result.hit_count);
+  printf("Miss count: %zu\n", result.miss_count);
+  printf("Clean evictions: %zu\n", result.evict_clean_count);
+  printf("Dirty evictions: %zu\n", result.evict_dirty_count);
+  printf("Total references: %zu\n", result.ref_count);
+  printf("Hit rate: %.4f\n",
+         ((double)result.hit_count / result.ref_count) * 100.0);
+  printf("Miss rate: %.4f\n",
+         ((double)result.miss_count / result.ref_count) * 100.0);
+  if (tlb_enabled) {
+    printf("TLB hit count: %zu\n", result.tlb_hit_count);
+    printf("TLB hit rate: %.4f\n",
+           ((double)result.tlb_hit_count / result.ref_count) * 100.0);
+    printf("Page walks: %zu\n", result.walk_count);
+  }
+  if (hugepage_enabled) {
+    print_hugepage_report(&result);
+  }
+  if (readahead_enabled) {
+    print_readahead_report(&result);
+  }
+  jobs[0].result = result;
+  if (result.num_procs > 1) {
+    print_process_report(jobs, 1, NULL);
+  }
 
   printf("Time to run simulation: %f\n", endtime - starttime);
   printf("Memory used by simulation: %lu bytes\n", bytes_used);
+  if (timeseries_enabled &&
+      write_timeseries(series_path, series_binary, jobs, 1) != 0) {
+    return 1;
+  }
+  free(result.procs);
+  free(result.series.samples);
+  free(jobs);
 
   return 0;
 }
@@ -7,21 +7,61 @@
 /* Simulated physical memory page frame size */
 #define SIMPAGESIZE 16
 
-extern size_t memsize;
+/* Each simulator instance runs on its own thread (see engine.h), so all
+ * per-instance state is thread-local. */
+extern _Thread_local size_t memsize;
 extern bool debug;
 
-extern size_t hit_count;
-extern size_t miss_count;
-extern size_t ref_count;
-extern size_t evict_clean_count;
-extern size_t evict_dirty_count;
+extern _Thread_local size_t hit_count;
+extern _Thread_local size_t miss_count;
+extern _Thread_local size_t ref_count;
+extern _Thread_local size_t evict_clean_count;
+extern _Thread_local size_t evict_dirty_count;
+extern _Thread_local size_t tlb_hit_count;
+extern _Thread_local size_t walk_count;
+
+/* Counters of each process in the trace, indexed by pid. The array grows
+ * to the highest pid referenced so far. */
+struct proc_stats
+{
+  size_t hit_count;
+  size_t miss_count;
+  size_t evict_count; // pages of this process evicted, by anyone
+};
+
+/* Huge page events (see hugepage.h), all 0 unless huge pages are enabled */
+struct hugepage_stats
+{
+  size_t promotions;
+  size_t splits;
+  size_t populated;      // pages brought in to complete a huge page
+  size_t faults_avoided; // populated pages later referenced while resident
+  size_t extra_writes;   // dirty evictions of pages never referenced, or
+                         // dirty only through their huge page
+};
+
+/* Swap readahead events (see readahead.h), all 0 unless it is enabled */
+struct readahead_stats
+{
+  size_t windows; // faults that read ahead
+  size_t pages;   // pages read ahead
+  size_t used;    // pages read ahead and referenced before eviction, each
+                  // a fault avoided
+  size_t reads;   // swap reads that brought them in
+};
+
+extern _Thread_local struct hugepage_stats hugepage_stats;
+extern _Thread_local struct readahead_stats readahead_stats;
+extern _Thread_local struct proc_stats* proc_stats;
+extern _Thread_local size_t num_procs;
 
 /* We simulate physical memory with a large array of bytes */
-extern unsigned char* physmem;
+extern _Thread_local unsigned char* physmem;
 
-extern void (*ref_func)(int frame);
-extern int (*evict_func)(void);
+extern _Thread_local void (*ref_func)(int frame);
+extern _Thread_local int (*evict_func)(void);
 
-extern char* tracefile; // for opt
+extern _Thread_local char* tracefile; // for opt
+extern _Thread_local int instance_pid; // process replayed, -1 for all
 
 #endif /* CSC369_SIM_H */
@@ -0,0 +1,323 @@
+/*
+ * Runs a grid of simulations (every trace x memory size x algorithm) on a
+ * pool of threads and prints the results as one CSV.
+ *
+ * Each trace is loaded once: binary traces are used in place from their
+ * mapping, and other traces are read once into the same record encoding.
+ * Every job then replays the shared records in its own simulator instance.
+ * If opt is among the algorithms, the next uses it needs are also computed
+ * once per trace and shared by its jobs.
+ *
+ * USAGE: simsweep -f tracefile [-f tracefile ...] -m memsize[,memsize...]
+ *                 -a algorithm[,algorithm...] -s swapsize [-S backend]
+ *                 [-T entries[:ways[:policy]]] [-H order[:threshold]]
+ *                 [-R pages] [-j threads]
+ */
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "engine.h"
+#include "hugepage.h"
+#include "readahead.h"
+#include "sim.h"
+#include "swap.h"
+#include "tlb.h"
+#include "trace.h"
+
+#define MAX_TRACES 64
+#define MAX_MEMSIZES 256
+#define MAX_ALGS 16
+
+bool debug = false;
+_Thread_local char* tracefile = NULL;
+
+struct sweep_trace
+{
+  char* path;
+  trace_t trace;       // open while records point into its mapping
+  uint64_t* owned;     // records read from any other trace
+  const uint64_t* records;
+  size_t count;
+  struct opt_trace* opt; // next uses for opt, if it is swept
+};
+
+struct sweep_job
+{
+  struct sweep_trace* trace;
+  struct sim_job sim;
+};
+
+static struct sweep_job* jobs;
+static size_t num_jobs;
+static atomic_size_t next_job;
+
+/*
+ * Makes the references of a trace available as encoded records. Returns 0
+ * on success, -1 on failure.
+ */
+static int
+load_trace(struct sweep_trace* st)
+{
+  if (trace_open(&st->trace, st->path) != 0) {
+    return -1;
+  }
+  if (st->trace.map != NULL) {
+    st->records = st->trace.records;
+    st->count = st->trace.count;
+    return 0;
+  }
+
+  size_t cap = 1 << 20;
+  st->owned = malloc(cap * sizeof(uint64_t));
+  st->count = 0;
+  unsigned short pid = 0;
+  struct trace_ref ref;
+  while (st->owned && trace_next(&st->trace, &ref)) {
+    if (st->count + 1 >= cap) {
+      cap *= 2;
+      st->owned = realloc(st->owned, cap * sizeof(uint64_t));
+      if (!st->owned) {
+        break;
+      }
+    }
+    if (ref.pid != pid) {
+      pid = ref.pid;
+      st->owned[st->count++] = trace_encode_pid(pid);
+    }
+    st->owned[st->count++] = trace_encode(&ref);
+  }
+  trace_close(&st->trace);
+  if (!st->owned) {
+    perror(st->path);
+    return -1;
+  }
+  st->records = st->owned;
+  return 0;
+}
+
+static void*
+sweep_worker(void* arg)
+{
+  (void)arg;
+  while (1) {
+    size_t j = atomic_fetch_add(&next_job, 1);
+    if (j >= num_jobs) {
+      return NULL;
+    }
+    struct sweep_job* job = &jobs[j];
+    tracefile = job->trace->path;
+    opt_shared_trace = job->trace->opt;
+    sim_instance_init(job->sim.alg, job->sim.memsize, job->sim.swapsize);
+    sim_instance_start();
+    sim_replay_records(job->trace->records, job->trace->count);
+    sim_instance_finish(&job->sim.result);
+  }
+}
+
+static size_t
+parse_sizes(char* arg, size_t* sizes, size_t max_sizes)
+{
+  size_t n = 0;
+  char* saveptr = NULL;
+  for (char* s = strtok_r(arg, ",", &saveptr); s != NULL;
+       s = strtok_r(NULL, ",", &saveptr)) {
+    size_t size = strtoul(s, NULL, 10);
+    if (size == 0 || n == max_sizes) {
+      fprintf(stderr, "Error: invalid memory size - %s\n", s);
+      return 0;
+    }
+    sizes[n++] = size;
+  }
+  return n;
+}
+
+int
+main(int argc, char* argv[])
+{
+  struct sweep_trace traces[MAX_TRACES];
+  size_t num_traces = 0;
+  size_t memsizes[MAX_MEMSIZES];
+  size_t num_memsizes = 0;
+  int algs[MAX_ALGS];
+  size_t num_algs = 0;
+  size_t swapsize = 0;
+  long num_threads = sysconf(_SC_NPROCESSORS_ONLN);
+  const char* usage =
+    "USAGE: simsweep -f tracefile [-f tracefile ...] "
+    "-m memsize[,memsize...]\n"
+    "                -a algorithm[,algorithm...] -s swapsize [-S backend]\n"
+    "                [-T entries[:ways[:policy]]] [-H order[:threshold]]\n"
+    "                [-R pages] [-j threads]\n";
+
+  int opt;
+  while ((opt = getopt(argc, argv, "f:m:a:s:S:T:H:R:j:")) != -1) {
+    switch (opt) {
+      case 'f':
+        if (num_traces == MAX_TRACES) {
+          fprintf(stderr, "Error: too many traces\n");
+          return 1;
+        }
+        memset(&traces[num_traces], 0, sizeof(traces[0]));
+        traces[num_traces++].path = optarg;
+        break;
+      case 'm':
+        if ((num_memsizes = parse_sizes(optarg, memsizes, MAX_MEMSIZES)) == 0)
+          return 1;
+        break;
+      case 'a':
+        if ((num_algs = sim_parse_algs(optarg, algs, MAX_ALGS)) == 0)
+          return 1;
+        break;
+      case 's':
+        swapsize = strtoul(optarg, NULL, 10);
+        break;
+      case 'S':
+        if (swap_set_backend(optarg) != 0) {
+          fprintf(stderr, "Error: invalid swap backend - %s\n", optarg);
+          return 1;
+        }
+        break;
+      case 'T':
+        if (tlb_configure(optarg) != 0) {
+          fprintf(stderr, "Error: invalid TLB configuration - %s\n", optarg);
+          return 1;
+        }
+        break;
+      case 'H':
+        if (hugepage_configure(optarg) != 0) {
+          fprintf(stderr,
+                  "Error: invalid huge page configuration - %s\n",
+                  optarg);
+          return 1;
+        }
+        break;
+      case 'R':
+        if (readahead_configure(optarg) != 0) {
+          fprintf(stderr, "Error: invalid readahead window - %s\n", optarg);
+          return 1;
+        }
+        break;
+      case 'j':
+        num_threads = strtol(optarg, NULL, 10);
+        break;
+      default:
+        fprintf(stderr, "%s", usage);
+        return 1;
+    }
+  }
+  if (!num_traces || !num_memsizes || !num_algs || !swapsize ||
+      num_threads < 1) {
+    fprintf(stderr, "%s", usage);
+    return 1;
+  }
+
+  bool sweep_opt = false;
+  for (size_t a = 0; a < num_algs; a++) {
+    sweep_opt |= algs[a] == sim_find_alg("opt");
+  }
+  for (size_t t = 0; t < num_traces; t++) {
+    if (load_trace(&traces[t]) != 0) {
+      return 1;
+    }
+    if (sweep_opt && !(traces[t].opt = opt_trace_from_records(
+                         traces[t].records, traces[t].count))) {
+      perror("simsweep");
+      return 1;
+    }
+  }
+
+  num_jobs = num_traces * num_memsizes * num_algs;
+  jobs = malloc(num_jobs * sizeof(struct sweep_job));
+  if (!jobs) {
+    perror("simsweep");
+    return 1;
+  }
+  size_t j = 0;
+  for (size_t t = 0; t < num_traces; t++) {
+    for (size_t m = 0; m < num_memsizes; m++) {
+      for (size_t a = 0; a < num_algs; a++) {
+        jobs[j].trace = &traces[t];
+        jobs[j].sim.alg = algs[a];
+        jobs[j].sim.memsize = memsizes[m];
+        jobs[j].sim.swapsize = swapsize;
+        j++;
+      }
+    }
+  }
+
+  if ((size_t)num_threads > num_jobs) {
+    num_threads = num_jobs;
+  }
+  pthread_t* threads = malloc(num_threads * sizeof(pthread_t));
+  if (!threads) {
+    perror("simsweep");
+    return 1;
+  }
+  atomic_init(&next_job, 0);
+  for (long i = 0; i < num_threads; i++) {
+    int err = pthread_create(&threads[i], NULL, sweep_worker, NULL);
+    if (err != 0) {
+      fprintf(stderr, "simsweep: pthread_create: %s\n", strerror(err));
+      return 1;
+    }
+  }
+  for (long i = 0; i < num_threads; i++) {
+    pthread_join(threads[i], NULL);
+  }
+
+  printf("trace,algorithm,memsize,hits,misses,clean_evictions,"
+         "dirty_evictions,references,hit_rate,time%s%s%s\n",
+         tlb_enabled ? ",tlb_hits,page_walks" : "",
+         hugepage_enabled ? ",promotions,splits,populated,faults_avoided,"
+                            "huge_dirty_evictions"
+                          : "",
+         readahead_enabled ? ",readahead_pages,readahead_used,readahead_reads"
+                           : "");
+  for (j = 0; j < num_jobs; j++) {
+    const struct sim_result* r = &jobs[j].sim.result;
+    printf("%s,%s,%zu,%zu,%zu,%zu,%zu,%zu,%.4f,%f",
+           jobs[j].trace->path,
+           sim_alg_name(jobs[j].sim.alg),
+           jobs[j].sim.memsize,
+           r->hit_count,
+           r->miss_count,
+           r->evict_clean_count,
+           r->evict_dirty_count,
+           r->ref_count,
+           r->ref_count ? ((double)r->hit_count / r->ref_count) * 100.0 : 0.0,
+           r->time);
+    if (tlb_enabled) {
+      printf(",%zu,%zu", r->tlb_hit_count, r->walk_count);
+    }
+    if (hugepage_enabled) {
+      printf(",%zu,%zu,%zu,%zu,%zu",
+             r->huge.promotions,
+             r->huge.splits,
+             r->huge.populated,
+             r->huge.faults_avoided,
+             r->huge.extra_writes);
+    }
+    if (readahead_enabled) {
+      printf(",%zu,%zu,%zu",
+             r->readahead.pages,
+             r->readahead.used,
+             r->readahead.reads);
+    }
+    printf("\n");
+    free(r->procs);
+  }
+
+  free(threads);
+  free(jobs);
+  for (size_t t = 0; t < num_traces; t++) {
+    trace_close(&traces[t].trace);
+    free(traces[t].owned);
+    opt_trace_free(traces[t].opt);
+  }
+  return 0;
+}
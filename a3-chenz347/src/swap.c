@@ -4,6 +4,8 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/mman.h>
+#include <sys/uio.h>
 #include <unistd.h>
 
 #include "pagetable_generic.h"
@@ -26,23 +28,44 @@ nwords_for_nbits(size_t nbits)
   return (nbits + bits_per_word - 1) / bits_per_word;
 }
 
+// The summary has one bit per word of the bitmap, set when that word is
+// full, so a free bit can be found without visiting full words. Searches
+// start at the bit after the previous allocation (the hint) and wrap
+// around, so pages evicted one after another get consecutive slots as
+// long as there is free space ahead, and can be read back in one go.
 struct bitmap
 {
   size_t nbits;
   size_t* words;
+  size_t* summary;
+  size_t hint;
 };
 
+static void
+bitmap_update_summary(struct bitmap* b, size_t idx)
+{
+  size_t mask = (size_t)1 << (idx % bits_per_word);
+  if (b->words[idx] == word_all_bits) {
+    b->summary[idx / bits_per_word] |= mask;
+  } else {
+    b->summary[idx / bits_per_word] &= ~mask;
+  }
+}
+
 static int
 bitmap_init(struct bitmap* b, size_t nbits)
 {
   size_t nwords = nwords_for_nbits(nbits);
-  b->words = malloc(nwords * sizeof(size_t));
-  if (!b->words) {
+  size_t nsummary = nwords_for_nbits(nwords);
+  b->words = calloc(nwords, sizeof(size_t));
+  b->summary = calloc(nsummary, sizeof(size_t));
+  if (!b->words || !b->summary) {
+    free(b->words);
+    free(b->summary);
     return -1;
   }
-
-  memset(b->words, 0, nwords * sizeof(size_t));
   b->nbits = nbits;
+  b->hint = 0;
 
   // Mark any leftover bits at the end in use
   if (nwords > nbits / bits_per_word) {
@@ -57,54 +80,287 @@ bitmap_init(struct bitmap* b, size_t nbits)
     }
   }
 
+  // Likewise in the summary, so that words past the end look full
+  size_t nsummary_bits = nsummary * bits_per_word;
+  for (size_t j = nwords; j < nsummary_bits; ++j) {
+    b->summary[j / bits_per_word] |= (size_t)1 << (j % bits_per_word);
+  }
+
   return 0;
 }
 
+/*
+ * Returns the index of the first word at or after start (wrapping around)
+ * that has a free bit, or -1 if every word is full.
+ */
+static long
+bitmap_find_word(const struct bitmap* b, size_t start)
+{
+  size_t nsummary = nwords_for_nbits(nwords_for_nbits(b->nbits));
+  size_t s = start / bits_per_word;
+
+  // Words at or after start in start's summary word
+  size_t free_words =
+    ~b->summary[s] & (word_all_bits << (start % bits_per_word));
+  for (size_t n = 0; n <= nsummary; ++n) {
+    if (free_words != 0) {
+      return s * bits_per_word + __builtin_ctzl(free_words);
+    }
+    s = (s + 1) % nsummary;
+    free_words = ~b->summary[s];
+  }
+  return -1;
+}
+
 static int
 bitmap_alloc(struct bitmap* b, size_t* index)
 {
-  size_t max_idx = nwords_for_nbits(b->nbits);
-
-  for (size_t idx = 0; idx < max_idx; ++idx) {
-    if (b->words[idx] != word_all_bits) {
-      for (size_t offset = 0; offset < bits_per_word; ++offset) {
-        size_t mask = (size_t)1 << offset;
-
-        if ((b->words[idx] & mask) == 0) {
-          b->words[idx] |= mask;
-          *index = (idx * bits_per_word) + offset;
-          assert(*index < b->nbits);
-          return 0;
-        }
-      }
-      assert(false);
+  size_t nwords = nwords_for_nbits(b->nbits);
+  long idx = b->hint / bits_per_word;
+  size_t free_bits =
+    ~b->words[idx] & (word_all_bits << (b->hint % bits_per_word));
+  if (free_bits == 0) {
+    idx = bitmap_find_word(b, (idx + 1) % nwords);
+    if (idx == -1) {
+      return -1;
     }
+    free_bits = ~b->words[idx];
   }
-  return -1;
+
+  size_t offset = __builtin_ctzl(free_bits);
+  b->words[idx] |= (size_t)1 << offset;
+  bitmap_update_summary(b, idx);
+
+  *index = (idx * bits_per_word) + offset;
+  assert(*index < b->nbits);
+  b->hint = (*index + 1) % b->nbits;
+  return 0;
+}
+
+static void
+bitmap_unmark(struct bitmap* b, size_t index)
+{
+  size_t idx = index / bits_per_word;
+  size_t mask = (size_t)1 << (index % bits_per_word);
+
+  assert(index < b->nbits);
+  assert((b->words[idx] & mask) != 0);
+  b->words[idx] &= ~mask;
+  bitmap_update_summary(b, idx);
 }
 
 static void
 bitmap_destroy(struct bitmap* b)
 {
   free(b->words);
+  free(b->summary);
 }
 
 //---------------------------------------------------------------------
-// Swap definitions and functions.
+// Swap backends. Each backend stores page data at byte offsets handed out
+// by the bitmap; the backend in use is chosen once, before any instance
+// calls swap_init, and its state is per instance.
 
-static int swapfd;
-static struct bitmap swapmap;
-static char fname[20];
+struct swap_backend
+{
+  const char* name;
+  void (*init)(size_t size); // size is the number of pages of swap
+  void (*destroy)(void);
+  int (*read)(void* buf, off_t offset);        // 0 on success
+  int (*write)(const void* buf, off_t offset); // 0 on success
+  // Reads n pages from consecutive slots starting at offset; 0 on success
+  int (*readv)(void* const* bufs, size_t n, off_t offset);
+};
 
-void
-swap_init(size_t size)
+static _Thread_local int swapfd;
+static _Thread_local char fname[20];
+static _Thread_local unsigned char* swapmem;
+static _Thread_local size_t swapmem_len;
+
+static void
+swapfile_create(void)
 {
-  // Initialize the swap file
   strncpy(fname, "swapfile.XXXXXX", sizeof(fname));
   if ((swapfd = mkstemp(fname)) == -1) {
     perror("Failed to create temporary file for swap");
     exit(1);
   }
+}
+
+static void
+swapfile_remove(void)
+{
+  // Close and remove swapfile
+  close(swapfd);
+  unlink(fname);
+}
+
+// "file": a temporary file accessed with pread/pwrite, one syscall per page
+
+static void
+file_init(size_t size)
+{
+  (void)size;
+  swapfile_create();
+}
+
+static int
+file_read(void* buf, off_t offset)
+{
+  ssize_t bytes_read = pread(swapfd, buf, SIMPAGESIZE, offset);
+  if (bytes_read != SIMPAGESIZE) {
+    if (bytes_read == -1) {
+      perror("swap_pagein");
+      return -errno;
+    }
+    fprintf(stderr, "swap_pagein: did not read whole page\n");
+    return bytes_read;
+  }
+  return 0;
+}
+
+static int
+file_readv(void* const* bufs, size_t n, off_t offset)
+{
+  struct iovec iov[n];
+  for (size_t i = 0; i < n; i++) {
+    iov[i].iov_base = bufs[i];
+    iov[i].iov_len = SIMPAGESIZE;
+  }
+  ssize_t bytes_read = preadv(swapfd, iov, n, offset);
+  if (bytes_read != (ssize_t)(n * SIMPAGESIZE)) {
+    if (bytes_read == -1) {
+      perror("swap_pagein_run");
+      return -errno;
+    }
+    fprintf(stderr, "swap_pagein_run: did not read whole pages\n");
+    return bytes_read;
+  }
+  return 0;
+}
+
+static int
+file_write(const void* buf, off_t offset)
+{
+  ssize_t bytes_written = pwrite(swapfd, buf, SIMPAGESIZE, offset);
+  if (bytes_written != SIMPAGESIZE) {
+    fprintf(stderr, "swap_pageout: did not write whole page\n");
+    return -1;
+  }
+  return 0;
+}
+
+// "mem": an in-memory array, for policy studies that do not need real I/O
+
+static void
+mem_init(size_t size)
+{
+  swapmem_len = size * SIMPAGESIZE;
+  swapmem = malloc(swapmem_len);
+  if (!swapmem) {
+    perror("Failed to allocate memory for swap");
+    exit(1);
+  }
+}
+
+static void
+mem_destroy(void)
+{
+  free(swapmem);
+  swapmem = NULL;
+}
+
+// "mmap": the swap file mapped into memory, so moving a page is a memcpy
+
+static void
+mmap_init(size_t size)
+{
+  swapfile_create();
+  swapmem_len = size * SIMPAGESIZE;
+  if (ftruncate(swapfd, swapmem_len) != 0) {
+    perror("Failed to size swapfile");
+    exit(1);
+  }
+  swapmem = mmap(NULL, swapmem_len, PROT_READ | PROT_WRITE, MAP_SHARED,
+                 swapfd, 0);
+  if (swapmem == MAP_FAILED) {
+    perror("Failed to map swapfile");
+    exit(1);
+  }
+}
+
+static void
+mmap_destroy(void)
+{
+  munmap(swapmem, swapmem_len);
+  swapmem = NULL;
+  swapfile_remove();
+}
+
+// Shared by the "mem" and "mmap" backends
+
+static int
+memcpy_read(void* buf, off_t offset)
+{
+  memcpy(buf, swapmem + offset, SIMPAGESIZE);
+  return 0;
+}
+
+static int
+memcpy_write(const void* buf, off_t offset)
+{
+  memcpy(swapmem + offset, buf, SIMPAGESIZE);
+  return 0;
+}
+
+static int
+memcpy_readv(void* const* bufs, size_t n, off_t offset)
+{
+  for (size_t i = 0; i < n; i++) {
+    memcpy(bufs[i], swapmem + offset + i * SIMPAGESIZE, SIMPAGESIZE);
+  }
+  return 0;
+}
+
+static const struct swap_backend backends[] = {
+  { "file", file_init, swapfile_remove, file_read, file_write, file_readv },
+  { "mem", mem_init, mem_destroy, memcpy_read, memcpy_write, memcpy_readv },
+  { "mmap",
+    mmap_init,
+    mmap_destroy,
+    memcpy_read,
+    memcpy_write,
+    memcpy_readv },
+};
+static const size_t num_backends = sizeof(backends) / sizeof(backends[0]);
+
+static const struct swap_backend* backend = &backends[0];
+
+/*
+ * Selects the swap backend by name ("file", "mem" or "mmap").
+ * Returns 0 on success, -1 if there is no such backend.
+ */
+int
+swap_set_backend(const char* name)
+{
+  for (size_t i = 0; i < num_backends; ++i) {
+    if (strcmp(backends[i].name, name) == 0) {
+      backend = &backends[i];
+      return 0;
+    }
+  }
+  return -1;
+}
+
+//---------------------------------------------------------------------
+// Swap definitions and functions.
+
+static _Thread_local struct bitmap swapmap;
+
+void
+swap_init(size_t size)
+{
+  backend->init(size);
 
   // Initialize the bitmap
   if (bitmap_init(&swapmap, size) != 0) {
@@ -116,9 +372,7 @@ swap_init(size_t size)
 void
 swap_destroy(void)
 {
-  // Close and remove swapfile
-  close(swapfd);
-  unlink(fname);
+  backend->destroy();
 
   // Destroy bitmap
   bitmap_destroy(&swapmap);
@@ -139,21 +393,34 @@ swap_pagein(unsigned int frame, off_t offset)
   // Get pointer to page data in (simulated) physical memory
   void* frame_ptr = &physmem[frame * SIMPAGESIZE];
 
-  // Seek to position in swap file where this page was stored
-  off_t pos = lseek(swapfd, offset, SEEK_SET);
-  if (pos != offset) {
-    assert(pos == (off_t)-1);
-    perror("swap_pagein: failed to set read position");
-    return -errno;
-  }
+  // Read page data from swap into memory
+  return backend->read(frame_ptr, offset);
+}
 
-  // Read page data from swapfile into memory
-  ssize_t bytes_read = read(swapfd, frame_ptr, SIMPAGESIZE);
-  if (bytes_read != SIMPAGESIZE) {
-    fprintf(stderr, "swap_pagein: did not read whole page\n");
-    return bytes_read;
+// Read n pages into (simulated) physical memory frames[0..n-1] from the
+// consecutive slots starting at 'offset' in swap file, in one read.
+// Return: 0 on success,
+//         -errno on error or number of bytes read on partial read
+//
+int
+swap_pagein_run(const unsigned int* frames, size_t n, off_t offset)
+{
+  assert(offset != INVALID_SWAP);
+
+  void* bufs[n];
+  for (size_t i = 0; i < n; i++) {
+    bufs[i] = &physmem[frames[i] * SIMPAGESIZE];
   }
-  return 0;
+  return backend->readv(bufs, n, offset);
+}
+
+// Releases the swap space at 'offset' so that it can be reused, once the
+// copy there is stale (the page was modified after it was read back in).
+void
+swap_free(off_t offset)
+{
+  assert(offset != INVALID_SWAP);
+  bitmap_unmark(&swapmap, offset / SIMPAGESIZE);
 }
 
 // Write data from (simulated) physical memory 'frame' to 'offset'
@@ -182,18 +449,8 @@ swap_pageout(unsigned int frame, off_t offset)
   // Get pointer to page data in (simulated) physical memory
   void* frame_ptr = &physmem[frame * SIMPAGESIZE];
 
-  // Seek to position in swap file where this page will be stored
-  off_t pos = lseek(swapfd, offset, SEEK_SET);
-  if (pos != offset) {
-    assert(pos == (off_t)-1);
-    perror("swap_pageout: failed to set write position");
-    return INVALID_SWAP;
-  }
-
-  // Read page data from swapfile into memory
-  ssize_t bytes_written = write(swapfd, frame_ptr, SIMPAGESIZE);
-  if (bytes_written != SIMPAGESIZE) {
-    fprintf(stderr, "swap_pageout: did not write whole page\n");
+  // Write page data from memory to swap
+  if (backend->write(frame_ptr, offset) != 0) {
     return INVALID_SWAP;
   }
   return offset;
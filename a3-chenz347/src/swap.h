@@ -5,6 +5,8 @@
 
 // Swap functions for use in other files
 
+int
+swap_set_backend(const char* name);
 void
 swap_init(size_t size);
 void
@@ -12,7 +14,11 @@ swap_destroy(void);
 
 int
 swap_pagein(unsigned int frame, off_t offset);
+int
+swap_pagein_run(const unsigned int* frames, size_t n, off_t offset);
 off_t
 swap_pageout(unsigned int frame, off_t offset);
+void
+swap_free(off_t offset);
 
 #endif /* CSC369_SWAP_H */
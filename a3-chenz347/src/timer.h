@@ -12,4 +12,13 @@ get_time()
   return t.tv_sec + t.tv_nsec / 1000000000.0;
 }
 
+// Returns the CPU time consumed by the calling thread, in seconds
+static inline double
+get_thread_time()
+{
+  struct timespec t;
+  clock_gettime(CLOCK_THREAD_CPUTIME_ID, &t);
+  return t.tv_sec + t.tv_nsec / 1000000000.0;
+}
+
 #endif /* CSC369_TIMER_H */
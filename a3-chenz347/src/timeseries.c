@@ -0,0 +1,228 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "engine.h"
+#include "sim.h"
+#include "timeseries.h"
+#include "vpnmap.h"
+
+bool timeseries_enabled = false;
+size_t timeseries_period;
+size_t timeseries_window;
+
+// The working set is kept exactly over a sliding window: ring holds the page
+// keys of the last timeseries_window references, and last_ref the number of
+// the last reference to every page seen. A page leaves the working set when
+// the reference that drops out of the window was its last one.
+static _Thread_local vaddr_t* ring;
+static _Thread_local struct vpnmap last_ref;
+static _Thread_local size_t working_set;
+
+static _Thread_local struct timeseries_sample* samples;
+static _Thread_local size_t num_samples;
+static _Thread_local size_t samples_cap;
+static _Thread_local struct timeseries_sample prev; // totals at last sample
+static _Thread_local size_t resident;
+
+/*
+ * Enables sampling every period references, given as "period[:window]".
+ * The working set window defaults to the period. Returns 0 on success, -1
+ * if spec is invalid.
+ */
+int
+timeseries_configure(const char* spec)
+{
+  char* end;
+  size_t period = strtoul(spec, &end, 10);
+  if (end == spec || period == 0) {
+    return -1;
+  }
+  size_t window = period;
+  if (*end == ':') {
+    const char* s = end + 1;
+    window = strtoul(s, &end, 10);
+    if (end == s || window == 0) {
+      return -1;
+    }
+  }
+  if (*end != '\0') {
+    return -1;
+  }
+
+  timeseries_period = period;
+  timeseries_window = window;
+  timeseries_enabled = true;
+  return 0;
+}
+
+void
+timeseries_init(void)
+{
+  if (!timeseries_enabled) {
+    return;
+  }
+  ring = malloc(timeseries_window * sizeof(vaddr_t));
+  if (!ring) {
+    perror("timeseries_init");
+    exit(1);
+  }
+  vpnmap_init(&last_ref);
+  working_set = 0;
+  samples = NULL;
+  num_samples = 0;
+  samples_cap = 0;
+  memset(&prev, 0, sizeof(prev));
+  resident = 0;
+}
+
+static void
+take_sample(void)
+{
+  if (num_samples == samples_cap) {
+    samples_cap = samples_cap ? 2 * samples_cap : 1024;
+    samples = realloc(samples, samples_cap * sizeof(samples[0]));
+    if (!samples) {
+      perror("timeseries");
+      exit(1);
+    }
+  }
+  struct timeseries_sample* s = &samples[num_samples++];
+  s->ref = ref_count;
+  s->refs = ref_count - prev.ref;
+  s->misses = miss_count - prev.misses;
+  s->dirty_evictions = evict_dirty_count - prev.dirty_evictions;
+  s->working_set = working_set;
+  s->resident = resident;
+  prev.ref = ref_count;
+  prev.misses = miss_count;
+  prev.dirty_evictions = evict_dirty_count;
+}
+
+/*
+ * Counts the reference just made (number ref_count) to the page with the
+ * given page key, with resident frames in use afterwards, and takes a
+ * sample at the end of every period.
+ */
+void
+timeseries_ref(vaddr_t key, size_t frames_in_use)
+{
+  size_t t = ref_count;
+  vaddr_t* slot = &ring[t % timeseries_window];
+  if (t > timeseries_window) {
+    uint64_t* last = vpnmap_find(&last_ref, *slot);
+    if (*last == t - timeseries_window) {
+      working_set--;
+    }
+  }
+  uint64_t* last = vpnmap_lookup(&last_ref, key, NULL);
+  if (*last == 0 || *last + timeseries_window <= t) {
+    working_set++;
+  }
+  *last = t;
+  *slot = key;
+
+  resident = frames_in_use;
+  if (t % timeseries_period == 0) {
+    take_sample();
+  }
+}
+
+/*
+ * Takes a last sample of the references since the previous one, if any,
+ * and hands the samples over to series.
+ */
+void
+timeseries_finish(struct timeseries* series)
+{
+  series->samples = NULL;
+  series->count = 0;
+  if (!timeseries_enabled) {
+    return;
+  }
+  if (ref_count > prev.ref) {
+    take_sample();
+  }
+  series->samples = samples;
+  series->count = num_samples;
+  samples = NULL;
+  free(ring);
+  ring = NULL;
+  vpnmap_destroy(&last_ref);
+}
+
+static int
+write_instance(FILE* f, bool binary, const struct sim_job* job)
+{
+  const char* alg = sim_alg_name(job->alg);
+  const struct timeseries* series = &job->result.series;
+  if (binary) {
+    struct timeseries_bin_header hdr;
+    memset(&hdr, 0, sizeof(hdr));
+    memcpy(hdr.magic, TIMESERIES_BIN_MAGIC, sizeof(hdr.magic));
+    hdr.version = TIMESERIES_BIN_VERSION;
+    hdr.record_size = sizeof(struct timeseries_sample);
+    hdr.count = series->count;
+    hdr.memsize = job->memsize;
+    hdr.pid = job->pid;
+    strncpy(hdr.alg, alg, sizeof(hdr.alg) - 1);
+    if (fwrite(&hdr, sizeof(hdr), 1, f) != 1 ||
+        fwrite(series->samples,
+               sizeof(struct timeseries_sample),
+               series->count,
+               f) != series->count) {
+      return -1;
+    }
+    return 0;
+  }
+
+  for (size_t i = 0; i < series->count; i++) {
+    const struct timeseries_sample* s = &series->samples[i];
+    fprintf(f, "%s,%zu,", alg, job->memsize);
+    if (job->pid >= 0) {
+      fprintf(f, "%d", job->pid);
+    }
+    fprintf(f,
+            ",%zu,%.4f,%.4f,%zu,%zu\n",
+            (size_t)s->ref,
+            ((double)s->misses / s->refs) * 100.0,
+            ((double)s->dirty_evictions / s->refs) * 100.0,
+            (size_t)s->working_set,
+            (size_t)s->resident);
+  }
+  return 0;
+}
+
+/*
+ * Writes the samples of the njobs finished instances to path, as CSV with
+ * the miss and dirty eviction rates of each sample as percentages of its
+ * references (the pid is empty for instances of all processes), or in
+ * binary. Returns 0 on success, -1 on error.
+ */
+int
+timeseries_write(const char* path,
+                 bool binary,
+                 const struct sim_job* jobs,
+                 size_t njobs)
+{
+  FILE* f = fopen(path, binary ? "wb" : "w");
+  if (!f) {
+    perror(path);
+    return -1;
+  }
+  if (!binary) {
+    fprintf(f,
+            "algorithm,memsize,pid,reference,miss_rate,dirty_eviction_rate,"
+            "working_set,resident_set\n");
+  }
+  for (size_t j = 0; j < njobs; j++) {
+    if (write_instance(f, binary, &jobs[j]) != 0) {
+      break;
+    }
+  }
+  if (ferror(f) | fclose(f)) {
+    perror(path);
+    return -1;
+  }
+  return 0;
+}
@@ -0,0 +1,74 @@
+#ifndef CSC369_TIMESERIES_H
+#define CSC369_TIMESERIES_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "pagetable_generic.h"
+
+// Optional time series of an instance. Every timeseries_period references,
+// the instance records a sample: the misses and dirty evictions since the
+// previous sample, the working set W(t, tau) (the distinct pages referenced
+// in the last tau = timeseries_window references, ending at reference t)
+// and the resident set (the frames in use). Each instance keeps its own
+// samples until they are handed over in its sim_result.
+//
+// Samples are written as CSV, one row per sample, or in binary: for each
+// instance a timeseries_bin_header followed by its samples as is, in host
+// byte order.
+
+#define TIMESERIES_BIN_MAGIC "CSC369TS"
+#define TIMESERIES_BIN_VERSION 1
+
+struct timeseries_sample
+{
+  uint64_t ref;             // references so far, t
+  uint64_t refs;            // references since the previous sample
+  uint64_t misses;          // misses since the previous sample
+  uint64_t dirty_evictions; // dirty evictions since the previous sample
+  uint64_t working_set;     // W(t, tau)
+  uint64_t resident;        // frames in use at t
+};
+
+struct timeseries_bin_header
+{
+  char magic[8];        // TIMESERIES_BIN_MAGIC, not NUL-terminated
+  uint32_t version;     // TIMESERIES_BIN_VERSION
+  uint32_t record_size; // sizeof(struct timeseries_sample)
+  uint64_t count;       // number of samples following the header
+  uint64_t memsize;     // frames of the instance
+  int32_t pid;          // process replayed, -1 for all
+  char alg[12];         // replacement algorithm, NUL-padded
+};
+
+// Samples of a finished instance
+struct timeseries
+{
+  struct timeseries_sample* samples; // freed by the caller
+  size_t count;
+};
+
+extern bool timeseries_enabled;
+extern size_t timeseries_period;
+extern size_t timeseries_window;
+
+int
+timeseries_configure(const char* spec);
+void
+timeseries_init(void);
+void
+timeseries_finish(struct timeseries* series);
+
+void
+timeseries_ref(vaddr_t key, size_t resident);
+
+struct sim_job;
+
+int
+timeseries_write(const char* path,
+                 bool binary,
+                 const struct sim_job* jobs,
+                 size_t njobs);
+
+#endif /* CSC369_TIMESERIES_H */
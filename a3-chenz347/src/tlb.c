@@ -0,0 +1,165 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "tlb.h"
+
+// Entries of a set are contiguous, so a lookup scans one short run of
+// tags. Tags are vpn + 1, so 0 marks an invalid entry.
+
+enum tlb_policy
+{
+  TLB_LRU,
+  TLB_FIFO,
+  TLB_RAND,
+};
+
+static const char* const policy_names[] = { "lru", "fifo", "rand" };
+
+bool tlb_enabled = false;
+static size_t tlb_sets;
+static size_t tlb_ways;
+static enum tlb_policy tlb_policy;
+
+static _Thread_local uint64_t* tlb_tags;
+static _Thread_local struct pt_entry_s** tlb_ptes;
+static _Thread_local uint64_t* tlb_stamps; // last use (LRU) or fill (FIFO)
+static _Thread_local uint64_t tlb_clock;
+static _Thread_local uint64_t tlb_rand_state;
+
+/*
+ * Enables the TLB with the geometry given as "entries[:ways[:policy]]",
+ * where policy is lru (the default), fifo or rand. Ways defaults to 4 (or
+ * entries, if fewer); entries / ways must be a power of 2. Returns 0 on
+ * success, -1 if spec is invalid.
+ */
+int
+tlb_configure(const char* spec)
+{
+  char* end;
+  size_t entries = strtoul(spec, &end, 10);
+  size_t ways = entries < 4 ? entries : 4;
+  enum tlb_policy policy = TLB_LRU;
+  if (*end == ':') {
+    ways = strtoul(end + 1, &end, 10);
+  }
+  if (*end == ':') {
+    const char* name = end + 1;
+    size_t i;
+    for (i = 0; i < sizeof(policy_names) / sizeof(policy_names[0]); i++) {
+      if (strcmp(name, policy_names[i]) == 0) {
+        break;
+      }
+    }
+    if (i == sizeof(policy_names) / sizeof(policy_names[0])) {
+      return -1;
+    }
+    policy = i;
+    end += strlen(end);
+  }
+  if (*end != '\0' || entries == 0 || ways == 0 || entries % ways != 0) {
+    return -1;
+  }
+  size_t sets = entries / ways;
+  if ((sets & (sets - 1)) != 0) {
+    return -1;
+  }
+
+  tlb_sets = sets;
+  tlb_ways = ways;
+  tlb_policy = policy;
+  tlb_enabled = true;
+  return 0;
+}
+
+/* Allocates an empty TLB for the calling thread's instance. */
+void
+tlb_init(void)
+{
+  if (!tlb_enabled) {
+    return;
+  }
+  size_t entries = tlb_sets * tlb_ways;
+  tlb_tags = calloc(entries, sizeof(uint64_t));
+  tlb_ptes = calloc(entries, sizeof(struct pt_entry_s*));
+  tlb_stamps = calloc(entries, sizeof(uint64_t));
+  if (!tlb_tags || !tlb_ptes || !tlb_stamps) {
+    perror("tlb_init");
+    exit(1);
+  }
+  tlb_clock = 0;
+  tlb_rand_state = 0x9e3779b97f4a7c15ULL;
+}
+
+void
+tlb_destroy(void)
+{
+  free(tlb_tags);
+  free(tlb_ptes);
+  free(tlb_stamps);
+  tlb_tags = NULL;
+  tlb_ptes = NULL;
+  tlb_stamps = NULL;
+}
+
+static size_t
+tlb_set_base(vaddr_t vpn)
+{
+  return (vpn & (tlb_sets - 1)) * tlb_ways;
+}
+
+/* Returns the cached page table entry for vpn, or NULL on a TLB miss. */
+struct pt_entry_s*
+tlb_lookup(vaddr_t vpn)
+{
+  size_t base = tlb_set_base(vpn);
+  for (size_t i = base; i < base + tlb_ways; i++) {
+    if (tlb_tags[i] == vpn + 1) {
+      if (tlb_policy == TLB_LRU) {
+        tlb_stamps[i] = ++tlb_clock;
+      }
+      return tlb_ptes[i];
+    }
+  }
+  return NULL;
+}
+
+/* Caches the entry of a resident page after a miss, replacing one in its set. */
+void
+tlb_insert(vaddr_t vpn, struct pt_entry_s* pte)
+{
+  size_t base = tlb_set_base(vpn);
+  size_t victim = base;
+  for (size_t i = base; i < base + tlb_ways; i++) {
+    if (tlb_tags[i] == 0) {
+      victim = i;
+      break;
+    }
+    if (tlb_stamps[i] < tlb_stamps[victim]) {
+      victim = i;
+    }
+  }
+  if (tlb_tags[victim] != 0 && tlb_policy == TLB_RAND) {
+    // xorshift64
+    tlb_rand_state ^= tlb_rand_state << 13;
+    tlb_rand_state ^= tlb_rand_state >> 7;
+    tlb_rand_state ^= tlb_rand_state << 17;
+    victim = base + tlb_rand_state % tlb_ways;
+  }
+  tlb_tags[victim] = vpn + 1;
+  tlb_ptes[victim] = pte;
+  tlb_stamps[victim] = ++tlb_clock;
+}
+
+/* Drops the entry for vpn, if cached, when its page leaves memory. */
+void
+tlb_invalidate(vaddr_t vpn)
+{
+  size_t base = tlb_set_base(vpn);
+  for (size_t i = base; i < base + tlb_ways; i++) {
+    if (tlb_tags[i] == vpn + 1) {
+      tlb_tags[i] = 0;
+      return;
+    }
+  }
+}
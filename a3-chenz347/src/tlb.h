@@ -0,0 +1,30 @@
+#ifndef CSC369_TLB_H
+#define CSC369_TLB_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "pagetable_generic.h"
+
+// An optional set-associative TLB in front of the page table walk. It maps
+// the page keys (see PAGE_KEY) of resident pages to their page table entries,
+// and a page's entry is invalidated when the page is evicted, so a TLB hit
+// is always a page hit. Each instance starts with its own empty TLB.
+
+extern bool tlb_enabled;
+
+int
+tlb_configure(const char* spec);
+void
+tlb_init(void);
+void
+tlb_destroy(void);
+
+struct pt_entry_s*
+tlb_lookup(vaddr_t vpn);
+void
+tlb_insert(vaddr_t vpn, struct pt_entry_s* pte);
+void
+tlb_invalidate(vaddr_t vpn);
+
+#endif /* CSC369_TLB_H */
@@ -0,0 +1,217 @@
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "sim.h"
+#include "trace.h"
+#include "trace_stream.h"
+
+#define TRACE_CHUNK_RECORDS (1 << 16)
+
+/*
+ * Maps a binary trace into memory. Returns 0 on success, -1 if the file is
+ * truncated or was written by an incompatible version of trace2bin.
+ */
+static int
+trace_open_binary(trace_t* t, int fd, const char* path)
+{
+  struct stat st;
+  if (fstat(fd, &st) != 0) {
+    perror(path);
+    return -1;
+  }
+  size_t len = st.st_size;
+  if (len < sizeof(struct trace_bin_header)) {
+    fprintf(stderr, "%s: truncated trace header\n", path);
+    return -1;
+  }
+
+  void* map = mmap(NULL, len, PROT_READ, MAP_PRIVATE, fd, 0);
+  if (map == MAP_FAILED) {
+    perror(path);
+    return -1;
+  }
+  madvise(map, len, MADV_SEQUENTIAL);
+
+  const struct trace_bin_header* hdr = map;
+  if (hdr->version < 1 || hdr->version > TRACE_BIN_VERSION ||
+      hdr->record_size != sizeof(uint64_t) ||
+      hdr->count > (len - sizeof(*hdr)) / sizeof(uint64_t)) {
+    fprintf(stderr, "%s: unsupported or truncated binary trace\n", path);
+    munmap(map, len);
+    return -1;
+  }
+
+  t->map = map;
+  t->map_len = len;
+  t->records = (const uint64_t*)(hdr + 1);
+  t->count = hdr->count;
+  return 0;
+}
+
+/*
+ * Sets up reading binary records from the decompressed stream t->fp, whose
+ * first bytes have been checked to be the binary magic. Returns 0 on
+ * success, -1 on failure.
+ */
+static int
+trace_open_binary_stream(trace_t* t, const char* path)
+{
+  struct trace_bin_header hdr;
+  if (fread(&hdr, sizeof(hdr), 1, t->fp) != 1 ||
+      hdr.version < 1 || hdr.version > TRACE_BIN_VERSION ||
+      hdr.record_size != sizeof(uint64_t)) {
+    fprintf(stderr, "%s: unsupported or truncated binary trace\n", path);
+    return -1;
+  }
+  t->chunk = malloc(TRACE_CHUNK_RECORDS * sizeof(uint64_t));
+  if (!t->chunk) {
+    perror(path);
+    return -1;
+  }
+  t->records = t->chunk;
+  t->left = hdr.count;
+  return 0;
+}
+
+/*
+ * Refills the chunk of a compressed binary trace. Returns false at the end
+ * of the trace (always, for other traces). Exits if the trace is truncated.
+ */
+bool
+trace_next_chunk(trace_t* t)
+{
+  if (t->chunk == NULL || t->left == 0) {
+    return false;
+  }
+  size_t n = t->left < TRACE_CHUNK_RECORDS ? t->left : TRACE_CHUNK_RECORDS;
+  if (fread(t->chunk, sizeof(uint64_t), n, t->fp) != n) {
+    fprintf(stderr, "Truncated binary trace after record %zu\n", t->linenum);
+    exit(1);
+  }
+  t->left -= n;
+  t->count = n;
+  t->pos = 0;
+  return true;
+}
+
+/*
+ * Opens a text or binary trace, telling them apart by the binary magic, and
+ * either one compressed with gzip or zstd. Returns 0 on success, -1 on
+ * failure (after printing an error).
+ */
+int
+trace_open(trace_t* t, const char* path)
+{
+  memset(t, 0, sizeof(*t));
+
+  int fd = open(path, O_RDONLY);
+  if (fd == -1) {
+    perror(path);
+    return -1;
+  }
+
+  char magic[sizeof(((struct trace_bin_header*)0)->magic)];
+  ssize_t n = read(fd, magic, sizeof(magic));
+  if (n == (ssize_t)sizeof(magic) &&
+      memcmp(magic, TRACE_BIN_MAGIC, sizeof(magic)) == 0) {
+    int ret = trace_open_binary(t, fd, path);
+    close(fd);
+    return ret;
+  }
+
+  if (lseek(fd, 0, SEEK_SET) != 0) {
+    perror(path);
+    close(fd);
+    return -1;
+  }
+
+  enum trace_compression format =
+    trace_compression_of((unsigned char*)magic, n > 0 ? n : 0);
+  if (format == TRACE_UNCOMPRESSED) {
+    if ((t->fp = fdopen(fd, "r")) == NULL) {
+      perror(path);
+      close(fd);
+      return -1;
+    }
+    return 0;
+  }
+
+  // The decompressed bytes are again a text or a binary trace
+  size_t head_len = sizeof(magic);
+  if ((t->fp = trace_stream_open(fd, format, path, magic, &head_len)) == NULL) {
+    return -1;
+  }
+  if (head_len == sizeof(magic) &&
+      memcmp(magic, TRACE_BIN_MAGIC, sizeof(magic)) == 0 &&
+      trace_open_binary_stream(t, path) != 0) {
+    trace_close(t);
+    return -1;
+  }
+  return 0;
+}
+
+void
+trace_close(trace_t* t)
+{
+  if (t->fp != NULL) {
+    fclose(t->fp);
+  }
+  if (t->map != NULL) {
+    munmap(t->map, t->map_len);
+  }
+  free(t->chunk);
+  memset(t, 0, sizeof(*t));
+}
+
+/*
+ * Parses the next reference from a text trace. Exits on a malformed line,
+ * since the rest of the trace cannot be trusted.
+ */
+bool
+trace_next_text(trace_t* t, struct trace_ref* ref)
+{
+  char line[256];
+  while (fgets(line, sizeof(line), t->fp)) {
+    ++t->linenum;
+    if (line[0] == '=') {
+      continue;
+    }
+
+    unsigned long pid = 0;
+    int n = sscanf(
+      line, "%c %zx %hhu %lu", &ref->type, &ref->vaddr, &ref->val, &pid);
+    if (n < 3) {
+      fprintf(stderr, "Invalid trace line %zu: %s\n", t->linenum, line);
+      exit(1);
+    }
+    if (pid > TRACE_MAX_PID) {
+      fprintf(stderr, "Invalid pid, line %zu: %s\n", t->linenum, line);
+      exit(1);
+    }
+    ref->pid = pid;
+    if (ref->type != 'I' && ref->type != 'L' && ref->type != 'S' &&
+        ref->type != 'M') {
+      fprintf(stderr, "Invalid reftype, line %zu: %s\n", t->linenum, line);
+      exit(1);
+    }
+    if ((ref->vaddr % PAGE_SIZE) > SIMPAGESIZE) {
+      fprintf(stderr,
+              "Invalid vaddr, offset must be in range of simulated page frame "
+              "size, line %zu: %s\n",
+              t->linenum,
+              line);
+      exit(1);
+    }
+    return true;
+  }
+  if (ferror(t->fp)) {
+    fprintf(stderr, "Error reading trace after line %zu\n", t->linenum);
+    exit(1);
+  }
+  return false;
+}
@@ -0,0 +1,127 @@
+#ifndef CSC369_TRACE_H
+#define CSC369_TRACE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "pagetable_generic.h"
+
+// Traces come in two formats, detected automatically by trace_open():
+//
+// - Text: one "<type> <hex vaddr> <val> [pid]" reference per line, as
+//   produced by the scripts directory. Lines starting with '=' are skipped.
+// - Binary: a trace_bin_header followed by fixed 8-byte records in host
+//   byte order. The file is mapped into memory and walked without parsing.
+//
+// References without a pid belong to process 0. In binary traces, a record
+// of type TRACE_PID_TYPE carries the pid of the references that follow it
+// in its vaddr field instead of a reference.
+//
+// Either format may also be compressed with gzip or zstd, which is likewise
+// detected from its magic bytes and decompressed while the trace is read.
+//
+// 63       56 55       48 47                                          0
+// |----------|-----------|---------------------------------------------|
+//     type        val                        vaddr
+
+#define TRACE_BIN_MAGIC "CSC369TR"
+#define TRACE_BIN_VERSION 2 // version 1 had no pid records
+
+#define TRACE_VADDR_BITS 48
+#define TRACE_VADDR_MASK ((1ULL << TRACE_VADDR_BITS) - 1)
+#define TRACE_VAL_SHIFT 48
+#define TRACE_TYPE_SHIFT 56
+#define TRACE_PID_TYPE 'P'
+#define TRACE_MAX_PID 0xffff
+
+struct trace_bin_header
+{
+  char magic[8];        // TRACE_BIN_MAGIC, not NUL-terminated
+  uint32_t version;     // TRACE_BIN_VERSION
+  uint32_t record_size; // sizeof(uint64_t)
+  uint64_t count;       // number of records following the header
+};
+
+// A single memory reference
+struct trace_ref
+{
+  char type;         // 'I', 'L', 'S' or 'M'
+  unsigned char val; // value expected at (or written to) vaddr
+  unsigned short pid;
+  vaddr_t vaddr;
+};
+
+typedef struct
+{
+  FILE* fp;                // text or compressed traces only
+  const uint64_t* records; // binary traces only
+  size_t count;
+  size_t pos;
+  void* map;       // uncompressed binary trace: records is all of it
+  size_t map_len;
+  uint64_t* chunk; // compressed binary trace: records is a chunk of it
+  size_t left;     // records not yet read into the chunk
+  size_t linenum; // line (text) or record (binary) number of the last ref
+  unsigned short pid; // binary traces: pid of the following references
+} trace_t;
+
+int
+trace_open(trace_t* t, const char* path);
+void
+trace_close(trace_t* t);
+bool
+trace_next_text(trace_t* t, struct trace_ref* ref);
+bool
+trace_next_chunk(trace_t* t);
+
+static inline uint64_t
+trace_encode(const struct trace_ref* ref)
+{
+  return ((uint64_t)(unsigned char)ref->type << TRACE_TYPE_SHIFT) |
+         ((uint64_t)ref->val << TRACE_VAL_SHIFT) |
+         ((uint64_t)ref->vaddr & TRACE_VADDR_MASK);
+}
+
+static inline uint64_t
+trace_encode_pid(unsigned short pid)
+{
+  return ((uint64_t)TRACE_PID_TYPE << TRACE_TYPE_SHIFT) | pid;
+}
+
+/*
+ * Decodes a record into ref, with the pid of the references before it.
+ * Returns false for a pid record, which only updates *pid.
+ */
+static inline bool
+trace_decode(uint64_t record, unsigned short* pid, struct trace_ref* ref)
+{
+  ref->type = (char)(record >> TRACE_TYPE_SHIFT);
+  if (ref->type == TRACE_PID_TYPE) {
+    *pid = (unsigned short)record;
+    return false;
+  }
+  ref->val = (unsigned char)(record >> TRACE_VAL_SHIFT);
+  ref->pid = *pid;
+  ref->vaddr = record & TRACE_VADDR_MASK;
+  return true;
+}
+
+// Reads the next reference. Returns false at the end of the trace.
+static inline bool
+trace_next(trace_t* t, struct trace_ref* ref)
+{
+  if (t->records != NULL) {
+    do {
+      if (t->pos == t->count && !trace_next_chunk(t)) {
+        return false;
+      }
+      t->linenum++;
+    } while (!trace_decode(t->records[t->pos++], &t->pid, ref));
+    return true;
+  }
+  return trace_next_text(t, ref);
+}
+
+#endif /* CSC369_TRACE_H */
@@ -0,0 +1,91 @@
+/*
+ * Converts a text reference trace into the binary format described in
+ * trace.h, so that repeated simulator runs can map it instead of parsing it.
+ *
+ * USAGE: trace2bin input-trace output-trace
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "trace.h"
+
+#define RECORDS_PER_WRITE 4096
+
+int
+main(int argc, char* argv[])
+{
+  if (argc != 3) {
+    fprintf(stderr, "USAGE: trace2bin input-trace output-trace\n");
+    return 1;
+  }
+
+  trace_t in;
+  if (trace_open(&in, argv[1]) != 0) {
+    return 1;
+  }
+
+  FILE* out = fopen(argv[2], "wb");
+  if (!out) {
+    perror(argv[2]);
+    return 1;
+  }
+
+  // The count is patched in once the whole trace has been read
+  struct trace_bin_header hdr;
+  memcpy(hdr.magic, TRACE_BIN_MAGIC, sizeof(hdr.magic));
+  hdr.version = TRACE_BIN_VERSION;
+  hdr.record_size = sizeof(uint64_t);
+  hdr.count = 0;
+  if (fwrite(&hdr, sizeof(hdr), 1, out) != 1) {
+    perror(argv[2]);
+    return 1;
+  }
+
+  uint64_t buf[RECORDS_PER_WRITE];
+  size_t nbuf = 0;
+  size_t refs = 0;
+  unsigned short pid = 0;
+  struct trace_ref ref;
+  while (trace_next(&in, &ref)) {
+    if (ref.vaddr > TRACE_VADDR_MASK) {
+      fprintf(stderr,
+              "Invalid vaddr, must fit in %d bits, line %zu: %lx\n",
+              TRACE_VADDR_BITS,
+              in.linenum,
+              ref.vaddr);
+      return 1;
+    }
+    // A pid record precedes each run of references from another process
+    if (ref.pid != pid) {
+      pid = ref.pid;
+      buf[nbuf++] = trace_encode_pid(pid);
+    }
+    buf[nbuf++] = trace_encode(&ref);
+    refs++;
+    if (nbuf >= RECORDS_PER_WRITE - 1) {
+      if (fwrite(buf, sizeof(buf[0]), nbuf, out) != nbuf) {
+        perror(argv[2]);
+        return 1;
+      }
+      hdr.count += nbuf;
+      nbuf = 0;
+    }
+  }
+  if (fwrite(buf, sizeof(buf[0]), nbuf, out) != nbuf) {
+    perror(argv[2]);
+    return 1;
+  }
+  hdr.count += nbuf;
+
+  if (fseek(out, 0, SEEK_SET) != 0 || fwrite(&hdr, sizeof(hdr), 1, out) != 1 ||
+      fclose(out) != 0) {
+    perror(argv[2]);
+    return 1;
+  }
+  trace_close(&in);
+
+  printf("%s: %zu references\n", argv[2], refs);
+  return 0;
+}
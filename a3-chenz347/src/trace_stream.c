@@ -0,0 +1,389 @@
+#define _GNU_SOURCE // fopencookie
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#ifdef CSC369_HAVE_ZLIB
+#include <zlib.h>
+#endif
+#ifdef CSC369_HAVE_ZSTD
+#include <zstd.h>
+#endif
+
+#include "trace_stream.h"
+
+#define STREAM_BUF_SIZE (1 << 20) // decompressed bytes per buffer
+#define STREAM_IN_SIZE (1 << 17)  // compressed bytes per read()
+
+struct stream_buf
+{
+  unsigned char* data;
+  size_t len;
+  bool full; // filled by the decompressor and not yet drained by the reader
+};
+
+struct trace_stream
+{
+  int fd;
+  enum trace_compression format;
+  char* path;
+  pthread_t thread;
+
+  // Shared between the reader and the decompressor thread. A full buffer
+  // with len 0 marks the end of the stream.
+  pthread_mutex_t lock;
+  pthread_cond_t cond;
+  struct stream_buf buf[2];
+  bool closing; // the reader is gone; the decompressor should stop
+  bool failed;  // the stream ended early because of an error
+
+  // Reader side
+  int rd;
+  size_t rd_pos;
+
+  // Decompressor side
+  unsigned char in[STREAM_IN_SIZE];
+  size_t in_len;
+  bool frame_end; // the input so far ends on a complete gzip member/zstd frame
+#ifdef CSC369_HAVE_ZLIB
+  z_stream z;
+#endif
+#ifdef CSC369_HAVE_ZSTD
+  ZSTD_DStream* zd;
+  ZSTD_inBuffer zin;
+#endif
+};
+
+enum trace_compression
+trace_compression_of(const unsigned char* magic, size_t len)
+{
+  if (len >= 2 && magic[0] == 0x1f && magic[1] == 0x8b) {
+    return TRACE_GZIP;
+  }
+  if (len >= 4 && magic[0] == 0x28 && magic[1] == 0xb5 && magic[2] == 0x2f &&
+      magic[3] == 0xfd) {
+    return TRACE_ZSTD;
+  }
+  return TRACE_UNCOMPRESSED;
+}
+
+/*
+ * Reads the next block of compressed input. Returns the number of bytes
+ * read, 0 at the end of the file and -1 on error.
+ */
+static ssize_t
+stream_read_input(struct trace_stream* s)
+{
+  ssize_t n;
+  do {
+    n = read(s->fd, s->in, sizeof(s->in));
+  } while (n == -1 && errno == EINTR);
+  if (n == -1) {
+    perror(s->path);
+    return -1;
+  }
+  s->in_len = n;
+  return n;
+}
+
+#ifdef CSC369_HAVE_ZLIB
+/*
+ * Decompresses up to cap bytes into out, following concatenated gzip
+ * members. Returns the number of bytes produced (0 at the end) or -1.
+ */
+static ssize_t
+gzip_fill(struct trace_stream* s, unsigned char* out, size_t cap)
+{
+  z_stream* z = &s->z;
+  z->next_out = out;
+  z->avail_out = cap;
+  while (z->avail_out > 0) {
+    if (z->avail_in == 0) {
+      ssize_t n = stream_read_input(s);
+      if (n == -1) {
+        return -1;
+      }
+      if (n == 0) {
+        break;
+      }
+      z->next_in = s->in;
+      z->avail_in = n;
+    }
+    int ret = inflate(z, Z_NO_FLUSH);
+    if (ret == Z_STREAM_END) {
+      s->frame_end = true;
+      inflateReset(z);
+    } else if (ret == Z_OK) {
+      s->frame_end = false;
+    } else if (ret != Z_BUF_ERROR) {
+      fprintf(stderr, "%s: corrupt gzip stream\n", s->path);
+      return -1;
+    }
+  }
+  return cap - z->avail_out;
+}
+#endif
+
+#ifdef CSC369_HAVE_ZSTD
+// Same as gzip_fill(), for concatenated zstd frames.
+static ssize_t
+zstd_fill(struct trace_stream* s, unsigned char* out, size_t cap)
+{
+  ZSTD_outBuffer zout = { out, cap, 0 };
+  while (zout.pos < zout.size) {
+    if (s->zin.pos == s->zin.size) {
+      ssize_t n = stream_read_input(s);
+      if (n == -1) {
+        return -1;
+      }
+      if (n == 0) {
+        break;
+      }
+      s->zin.src = s->in;
+      s->zin.size = n;
+      s->zin.pos = 0;
+    }
+    size_t ret = ZSTD_decompressStream(s->zd, &zout, &s->zin);
+    if (ZSTD_isError(ret)) {
+      fprintf(stderr, "%s: %s\n", s->path, ZSTD_getErrorName(ret));
+      return -1;
+    }
+    s->frame_end = ret == 0;
+  }
+  return zout.pos;
+}
+#endif
+
+static ssize_t
+stream_fill(struct trace_stream* s, unsigned char* out, size_t cap)
+{
+  ssize_t n = -1;
+  switch (s->format) {
+#ifdef CSC369_HAVE_ZLIB
+    case TRACE_GZIP:
+      n = gzip_fill(s, out, cap);
+      break;
+#endif
+#ifdef CSC369_HAVE_ZSTD
+    case TRACE_ZSTD:
+      n = zstd_fill(s, out, cap);
+      break;
+#endif
+    default:
+      break;
+  }
+  if (n == 0 && !s->frame_end) {
+    fprintf(stderr, "%s: truncated compressed trace\n", s->path);
+    return -1;
+  }
+  return n;
+}
+
+// Decompressor thread: fills the two buffers in turn until the end
+static void*
+stream_thread(void* arg)
+{
+  struct trace_stream* s = arg;
+  for (int w = 0;; w ^= 1) {
+    pthread_mutex_lock(&s->lock);
+    while (s->buf[w].full && !s->closing) {
+      pthread_cond_wait(&s->cond, &s->lock);
+    }
+    bool closing = s->closing;
+    pthread_mutex_unlock(&s->lock);
+    if (closing) {
+      return NULL;
+    }
+
+    ssize_t n = stream_fill(s, s->buf[w].data, STREAM_BUF_SIZE);
+
+    pthread_mutex_lock(&s->lock);
+    s->buf[w].len = n > 0 ? n : 0;
+    s->buf[w].full = true;
+    s->failed = n == -1;
+    pthread_cond_broadcast(&s->cond);
+    pthread_mutex_unlock(&s->lock);
+    if (n <= 0) {
+      return NULL;
+    }
+  }
+}
+
+// Waits for the buffer being read to be filled. Returns false on error.
+static bool
+stream_wait(struct trace_stream* s)
+{
+  struct stream_buf* b = &s->buf[s->rd];
+  pthread_mutex_lock(&s->lock);
+  while (!b->full) {
+    pthread_cond_wait(&s->cond, &s->lock);
+  }
+  bool failed = b->len == 0 && s->failed;
+  pthread_mutex_unlock(&s->lock);
+  return !failed;
+}
+
+static ssize_t
+stream_cookie_read(void* cookie, char* dst, size_t size)
+{
+  struct trace_stream* s = cookie;
+  if (!stream_wait(s)) {
+    errno = EIO;
+    return -1;
+  }
+  struct stream_buf* b = &s->buf[s->rd];
+  size_t n = b->len - s->rd_pos;
+  if (n > size) {
+    n = size;
+  }
+  memcpy(dst, b->data + s->rd_pos, n);
+  s->rd_pos += n;
+
+  // Hand a drained buffer back to the decompressor (but keep the end marker)
+  if (b->len != 0 && s->rd_pos == b->len) {
+    pthread_mutex_lock(&s->lock);
+    b->full = false;
+    pthread_cond_broadcast(&s->cond);
+    pthread_mutex_unlock(&s->lock);
+    s->rd ^= 1;
+    s->rd_pos = 0;
+  }
+  return n;
+}
+
+static void
+stream_free(struct trace_stream* s)
+{
+#ifdef CSC369_HAVE_ZLIB
+  if (s->format == TRACE_GZIP) {
+    inflateEnd(&s->z);
+  }
+#endif
+#ifdef CSC369_HAVE_ZSTD
+  if (s->format == TRACE_ZSTD) {
+    ZSTD_freeDStream(s->zd);
+  }
+#endif
+  pthread_mutex_destroy(&s->lock);
+  pthread_cond_destroy(&s->cond);
+  free(s->buf[0].data);
+  free(s->buf[1].data);
+  free(s->path);
+  close(s->fd);
+  free(s);
+}
+
+static int
+stream_cookie_close(void* cookie)
+{
+  struct trace_stream* s = cookie;
+  pthread_mutex_lock(&s->lock);
+  s->closing = true;
+  pthread_cond_broadcast(&s->cond);
+  pthread_mutex_unlock(&s->lock);
+  pthread_join(s->thread, NULL);
+  stream_free(s);
+  return 0;
+}
+
+/*
+ * Sets up the decoder for the stream's format. Returns false if this build
+ * cannot read the format.
+ */
+static bool
+stream_init_decoder(struct trace_stream* s)
+{
+  switch (s->format) {
+    case TRACE_GZIP:
+#ifdef CSC369_HAVE_ZLIB
+      // 15 + 16: a gzip (not zlib) stream with the largest window
+      return inflateInit2(&s->z, 15 + 16) == Z_OK;
+#else
+      fprintf(stderr, "%s: built without gzip support\n", s->path);
+      return false;
+#endif
+    case TRACE_ZSTD:
+#ifdef CSC369_HAVE_ZSTD
+      s->zd = ZSTD_createDStream();
+      return s->zd != NULL && !ZSTD_isError(ZSTD_initDStream(s->zd));
+#else
+      fprintf(stderr, "%s: built without zstd support\n", s->path);
+      return false;
+#endif
+    default:
+      return false;
+  }
+}
+
+/*
+ * Starts decompressing fd (positioned at the start of the file) on a new
+ * thread and returns a stream of the decompressed bytes. The stream takes
+ * ownership of fd, which is closed with it (or right away on failure).
+ * The first *head_len decompressed bytes (fewer if the stream is shorter)
+ * are copied to head without being consumed, and *head_len is set to the
+ * number copied. Returns NULL on failure.
+ */
+FILE*
+trace_stream_open(int fd,
+                  enum trace_compression format,
+                  const char* path,
+                  void* head,
+                  size_t* head_len)
+{
+  struct trace_stream* s = calloc(1, sizeof(*s));
+  if (!s) {
+    perror(path);
+    close(fd);
+    return NULL;
+  }
+  s->fd = fd;
+  s->format = format;
+  s->path = strdup(path);
+  s->frame_end = true;
+  pthread_mutex_init(&s->lock, NULL);
+  pthread_cond_init(&s->cond, NULL);
+  s->buf[0].data = malloc(STREAM_BUF_SIZE);
+  s->buf[1].data = malloc(STREAM_BUF_SIZE);
+  if (!s->path || !s->buf[0].data || !s->buf[1].data) {
+    perror(path);
+    stream_free(s);
+    return NULL;
+  }
+  if (!stream_init_decoder(s)) {
+    stream_free(s);
+    return NULL;
+  }
+
+  int err = pthread_create(&s->thread, NULL, stream_thread, s);
+  if (err != 0) {
+    fprintf(stderr, "%s: pthread_create: %s\n", path, strerror(err));
+    stream_free(s);
+    return NULL;
+  }
+
+  if (!stream_wait(s)) {
+    pthread_join(s->thread, NULL);
+    stream_free(s);
+    return NULL;
+  }
+  if (*head_len > s->buf[0].len) {
+    *head_len = s->buf[0].len;
+  }
+  memcpy(head, s->buf[0].data, *head_len);
+
+  cookie_io_functions_t io = { .read = stream_cookie_read,
+                               .close = stream_cookie_close };
+  FILE* fp = fopencookie(s, "r", io);
+  if (!fp) {
+    perror(path);
+    stream_cookie_close(s);
+    return NULL;
+  }
+  return fp;
+}
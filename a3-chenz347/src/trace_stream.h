@@ -0,0 +1,27 @@
+#ifndef CSC369_TRACE_STREAM_H
+#define CSC369_TRACE_STREAM_H
+
+#include <stddef.h>
+#include <stdio.h>
+
+// Compressed traces are decompressed on a separate thread into two
+// buffers: the reader drains one while the thread refills the other.
+
+enum trace_compression
+{
+  TRACE_UNCOMPRESSED,
+  TRACE_GZIP,
+  TRACE_ZSTD,
+};
+
+enum trace_compression
+trace_compression_of(const unsigned char* magic, size_t len);
+
+FILE*
+trace_stream_open(int fd,
+                  enum trace_compression format,
+                  const char* path,
+                  void* head,
+                  size_t* head_len);
+
+#endif /* CSC369_TRACE_STREAM_H */
@@ -0,0 +1,365 @@
+/*
+ * Turns valgrind lackey output into a simulator trace in a single streaming
+ * pass. It does the work of the scripts in ../scripts, in order:
+ *
+ * - trimtrace.py: keep only the references between the start and end
+ *   markers of a benchmark (when --marker is given)
+ * - fastslim-with-offset.py: keep the first reference to each page in a
+ *   window of --buffersize distinct pages, emptying the window when a new
+ *   page arrives and it is full
+ * - simify-trace.py: scale page offsets down to --simpagesize, give stores
+ *   a random value and loads the last value stored at that address
+ *
+ * Store values come from the same generator as Python's random module, so
+ * for a given --seed the output is byte-identical to the Python pipeline
+ * with simify-trace.py --seed. With --binary the trace is written in the
+ * binary format read by sim (see trace.h); the output must then be a file.
+ *
+ * USAGE: tracegen [--marker markerfile] [--keepcode] [--buffersize N]
+ *                 [--simpagesize N] [--seed N] [--binary] [-o output]
+ *                 [lackey-output]
+ */
+
+#include <ctype.h>
+#include <getopt.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "trace.h"
+#include "vpnmap.h"
+
+//---------------------------------------------------------------------
+// MT19937, seeded the way CPython's random.seed() seeds it from an int.
+
+#define MT_N 624
+#define MT_M 397
+
+static uint32_t mt[MT_N];
+static int mti;
+
+static void
+mt_init_genrand(uint32_t s)
+{
+  mt[0] = s;
+  for (mti = 1; mti < MT_N; mti++) {
+    mt[mti] = 1812433253U * (mt[mti - 1] ^ (mt[mti - 1] >> 30)) + mti;
+  }
+}
+
+static void
+mt_init_by_array(const uint32_t* key, int key_length)
+{
+  mt_init_genrand(19650218U);
+  int i = 1;
+  int j = 0;
+  for (int k = MT_N > key_length ? MT_N : key_length; k; k--) {
+    mt[i] = (mt[i] ^ ((mt[i - 1] ^ (mt[i - 1] >> 30)) * 1664525U)) + key[j] +
+            j;
+    i++;
+    j++;
+    if (i >= MT_N) {
+      mt[0] = mt[MT_N - 1];
+      i = 1;
+    }
+    if (j >= key_length) {
+      j = 0;
+    }
+  }
+  for (int k = MT_N - 1; k; k--) {
+    mt[i] = (mt[i] ^ ((mt[i - 1] ^ (mt[i - 1] >> 30)) * 1566083941U)) - i;
+    i++;
+    if (i >= MT_N) {
+      mt[0] = mt[MT_N - 1];
+      i = 1;
+    }
+  }
+  mt[0] = 0x80000000U;
+}
+
+static uint32_t
+mt_genrand(void)
+{
+  static const uint32_t mag01[2] = { 0x0U, 0x9908b0dfU };
+  uint32_t y;
+
+  if (mti >= MT_N) {
+    int kk;
+    for (kk = 0; kk < MT_N - MT_M; kk++) {
+      y = (mt[kk] & 0x80000000U) | (mt[kk + 1] & 0x7fffffffU);
+      mt[kk] = mt[kk + MT_M] ^ (y >> 1) ^ mag01[y & 0x1U];
+    }
+    for (; kk < MT_N - 1; kk++) {
+      y = (mt[kk] & 0x80000000U) | (mt[kk + 1] & 0x7fffffffU);
+      mt[kk] = mt[kk + (MT_M - MT_N)] ^ (y >> 1) ^ mag01[y & 0x1U];
+    }
+    y = (mt[MT_N - 1] & 0x80000000U) | (mt[0] & 0x7fffffffU);
+    mt[MT_N - 1] = mt[MT_M - 1] ^ (y >> 1) ^ mag01[y & 0x1U];
+    mti = 0;
+  }
+
+  y = mt[mti++];
+  y ^= (y >> 11);
+  y ^= (y << 7) & 0x9d2c5680U;
+  y ^= (y << 15) & 0xefc60000U;
+  y ^= (y >> 18);
+  return y;
+}
+
+// random.seed(seed): the seed's 32-bit words, least significant first
+static void
+py_seed(uint64_t seed)
+{
+  uint32_t key[2] = { (uint32_t)seed, (uint32_t)(seed >> 32) };
+  mt_init_by_array(key, key[1] ? 2 : 1);
+}
+
+// random.randint(1, 255): rejection sampling on getrandbits(8)
+static unsigned char
+py_randint_1_255(void)
+{
+  uint32_t r;
+  do {
+    r = mt_genrand() >> 24;
+  } while (r >= 255);
+  return 1 + r;
+}
+
+//---------------------------------------------------------------------
+// Output, as text or as binary records.
+
+static FILE* out;
+static const char* out_path = "stdout";
+static bool binary;
+static struct trace_bin_header hdr;
+
+static void
+emit(char type, vaddr_t vaddr, unsigned char val)
+{
+  if (binary) {
+    struct trace_ref ref = { .type = type, .val = val, .vaddr = vaddr };
+    uint64_t rec = trace_encode(&ref);
+    if (fwrite(&rec, sizeof(rec), 1, out) != 1) {
+      perror(out_path);
+      exit(1);
+    }
+    hdr.count++;
+  } else if (fprintf(out, "%c %lx %hhu\n", type, vaddr, val) < 0) {
+    perror(out_path);
+    exit(1);
+  }
+}
+
+//---------------------------------------------------------------------
+
+/*
+ * Parses a stripped lackey line of the form "<type> <hex addr>,<size>".
+ * Returns false for anything else (valgrind messages, blank lines).
+ */
+static bool
+parse_lackey(const char* line, char* type, vaddr_t* addr)
+{
+  if (line[0] == '\0' || strchr("ILMS", line[0]) == NULL ||
+      !isspace((unsigned char)line[1])) {
+    return false;
+  }
+  const char* p = line + 1;
+  while (isspace((unsigned char)*p)) {
+    p++;
+  }
+  char* end;
+  if (!isxdigit((unsigned char)*p)) {
+    return false;
+  }
+  *addr = strtoul(p, &end, 16);
+  if (*end != ',') {
+    return false;
+  }
+  *type = line[0];
+  return true;
+}
+
+int
+main(int argc, char* argv[])
+{
+  const char* marker_path = NULL;
+  bool keepcode = false;
+  size_t buffersize = 4;
+  size_t simpagesize = 16;
+  bool seeded = false;
+  uint64_t seed = 0;
+  const char* usage =
+    "USAGE: tracegen [--marker markerfile] [--keepcode] [--buffersize N]\n"
+    "                [--simpagesize N] [--seed N] [--binary] [-o output]\n"
+    "                [lackey-output]\n";
+
+  static const struct option long_opts[] = {
+    { "marker", required_argument, NULL, 'm' },
+    { "keepcode", no_argument, NULL, 'k' },
+    { "buffersize", required_argument, NULL, 'b' },
+    { "simpagesize", required_argument, NULL, 's' },
+    { "seed", required_argument, NULL, 'r' },
+    { "binary", no_argument, NULL, 'B' },
+    { "output", required_argument, NULL, 'o' },
+    { NULL, 0, NULL, 0 },
+  };
+  int opt;
+  while ((opt = getopt_long(argc, argv, "m:kb:s:r:Bo:", long_opts, NULL)) !=
+         -1) {
+    switch (opt) {
+      case 'm':
+        marker_path = optarg;
+        break;
+      case 'k':
+        keepcode = true;
+        break;
+      case 'b':
+        buffersize = strtoul(optarg, NULL, 10);
+        break;
+      case 's':
+        simpagesize = strtoul(optarg, NULL, 10);
+        break;
+      case 'r':
+        seeded = true;
+        seed = strtoull(optarg, NULL, 10);
+        break;
+      case 'B':
+        binary = true;
+        break;
+      case 'o':
+        out_path = optarg;
+        break;
+      default:
+        fprintf(stderr, "%s", usage);
+        return 1;
+    }
+  }
+  if (optind < argc - 1 || buffersize == 0 || simpagesize == 0) {
+    fprintf(stderr, "%s", usage);
+    return 1;
+  }
+
+  FILE* in = stdin;
+  if (optind == argc - 1 && strcmp(argv[optind], "-") != 0) {
+    in = fopen(argv[optind], "r");
+    if (!in) {
+      perror(argv[optind]);
+      return 1;
+    }
+  }
+  out = strcmp(out_path, "stdout") == 0 ? stdout : fopen(out_path, "wb");
+  if (!out) {
+    perror(out_path);
+    return 1;
+  }
+
+  vaddr_t start_marker = 0;
+  vaddr_t end_marker = 0;
+  bool found_start = marker_path == NULL;
+  bool found_end = false;
+  if (marker_path != NULL) {
+    FILE* f = fopen(marker_path, "r");
+    if (!f || fscanf(f, "%lx %lx", &start_marker, &end_marker) != 2) {
+      fprintf(stderr, "%s: cannot read start and end markers\n", marker_path);
+      return 1;
+    }
+    fclose(f);
+  }
+
+  py_seed(seeded ? seed : (uint64_t)time(NULL) ^ ((uint64_t)getpid() << 32));
+
+  if (binary) {
+    memcpy(hdr.magic, TRACE_BIN_MAGIC, sizeof(hdr.magic));
+    hdr.version = TRACE_BIN_VERSION;
+    hdr.record_size = sizeof(uint64_t);
+    if (fwrite(&hdr, sizeof(hdr), 1, out) != 1) {
+      perror(out_path);
+      return 1;
+    }
+  }
+
+  // The fastslim window holds the pages whose value equals the current
+  // generation; bumping the generation empties it.
+  struct vpnmap window;
+  uint64_t generation = 1;
+  size_t window_len = 0;
+  // Last value stored at each (scaled) address; stores are never 0, so 0
+  // also stands for "never stored"
+  struct vpnmap vals;
+  vpnmap_init(&window);
+  vpnmap_init(&vals);
+
+  char buf[512];
+  while (fgets(buf, sizeof(buf), in)) {
+    char* line = buf;
+    while (isspace((unsigned char)*line)) {
+      line++;
+    }
+
+    char type;
+    vaddr_t addr;
+    if (!parse_lackey(line, &type, &addr)) {
+      continue;
+    }
+
+    // Trim to the marked region; the end marker itself is excluded
+    if (marker_path != NULL && type == 'S') {
+      if (addr == start_marker) {
+        if (found_start) {
+          fprintf(stderr, "Start marker appears more than once\n");
+          return 1;
+        }
+        found_start = true;
+      } else if (addr == end_marker) {
+        if (found_end) {
+          fprintf(stderr, "End marker appears more than once\n");
+          return 1;
+        }
+        found_end = true;
+      }
+    }
+    if (!found_start || found_end) {
+      continue;
+    }
+
+    // Fastslim: drop repeat references to pages already in the window
+    if (!keepcode && type == 'I') {
+      continue;
+    }
+    uint64_t* gen = vpnmap_lookup(&window, addr / PAGE_SIZE, NULL);
+    if (*gen == generation) {
+      continue;
+    }
+    if (window_len == buffersize) {
+      generation++;
+      window_len = 0;
+    }
+    *gen = generation;
+    window_len++;
+
+    // Simify: scale the offset and synthesize the value
+    vaddr_t vaddr = (addr / PAGE_SIZE) * PAGE_SIZE + addr % simpagesize;
+    uint64_t* val = vpnmap_lookup(&vals, vaddr, NULL);
+    if (type == 'S' || type == 'M') {
+      *val = py_randint_1_255();
+    }
+    emit(type, vaddr, (unsigned char)*val);
+  }
+
+  if (binary && (fseek(out, 0, SEEK_SET) != 0 ||
+                 fwrite(&hdr, sizeof(hdr), 1, out) != 1)) {
+    perror(out_path);
+    return 1;
+  }
+  if (ferror(out) || fclose(out) != 0) {
+    perror(out_path);
+    return 1;
+  }
+  vpnmap_destroy(&window);
+  vpnmap_destroy(&vals);
+  return 0;
+}
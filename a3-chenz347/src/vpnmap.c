@@ -0,0 +1,122 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "vpnmap.h"
+
+#define VPNMAP_INITIAL_SIZE 1024
+
+static size_t
+hash_vpn(uint64_t vpn)
+{
+  return (vpn * 0x9e3779b97f4a7c15ULL) >> 17;
+}
+
+static struct vpnmap_entry*
+find_slot(struct vpnmap_entry* slots, size_t size, uint64_t vpn)
+{
+  size_t i = hash_vpn(vpn) & (size - 1);
+  while (slots[i].key != 0 && slots[i].key != vpn + 1) {
+    i = (i + 1) & (size - 1);
+  }
+  return &slots[i];
+}
+
+static void
+vpnmap_alloc(struct vpnmap* map, size_t size)
+{
+  map->slots = calloc(size, sizeof(struct vpnmap_entry));
+  if (!map->slots) {
+    perror("vpnmap");
+    exit(1);
+  }
+  map->size = size;
+}
+
+void
+vpnmap_init(struct vpnmap* map)
+{
+  vpnmap_alloc(map, VPNMAP_INITIAL_SIZE);
+  map->count = 0;
+}
+
+void
+vpnmap_destroy(struct vpnmap* map)
+{
+  free(map->slots);
+  map->slots = NULL;
+  map->size = 0;
+  map->count = 0;
+}
+
+/*
+ * Returns a pointer to the value for vpn, inserting it with value 0 if it is
+ * not in the map yet. If inserted is not NULL, it is set to whether vpn was
+ * added. The pointer is valid until the next insertion.
+ */
+uint64_t*
+vpnmap_lookup(struct vpnmap* map, uint64_t vpn, bool* inserted)
+{
+  struct vpnmap_entry* slot = find_slot(map->slots, map->size, vpn);
+  if (inserted != NULL) {
+    *inserted = slot->key == 0;
+  }
+  if (slot->key != 0) {
+    return &slot->value;
+  }
+
+  // Keep the load factor at or below one half
+  if (2 * (map->count + 1) > map->size) {
+    struct vpnmap_entry* old = map->slots;
+    size_t old_size = map->size;
+    vpnmap_alloc(map, old_size * 2);
+    for (size_t i = 0; i < old_size; i++) {
+      if (old[i].key != 0) {
+        *find_slot(map->slots, map->size, old[i].key - 1) = old[i];
+      }
+    }
+    free(old);
+    slot = find_slot(map->slots, map->size, vpn);
+  }
+  slot->key = vpn + 1;
+  slot->value = 0;
+  map->count++;
+  return &slot->value;
+}
+
+/* Returns a pointer to the value for vpn, or NULL if it is not in the map. */
+uint64_t*
+vpnmap_find(struct vpnmap* map, uint64_t vpn)
+{
+  struct vpnmap_entry* slot = find_slot(map->slots, map->size, vpn);
+  return slot->key != 0 ? &slot->value : NULL;
+}
+
+/*
+ * Removes vpn from the map. Returns false if it was not in the map. Later
+ * entries of the same probe run are shifted back into the hole, so lookups
+ * never need tombstones.
+ */
+bool
+vpnmap_remove(struct vpnmap* map, uint64_t vpn)
+{
+  size_t mask = map->size - 1;
+  struct vpnmap_entry* slot = find_slot(map->slots, map->size, vpn);
+  if (slot->key == 0) {
+    return false;
+  }
+
+  size_t hole = slot - map->slots;
+  for (size_t i = (hole + 1) & mask; map->slots[i].key != 0;
+       i = (i + 1) & mask) {
+    // The entry at i may move to the hole unless its home slot lies
+    // (cyclically) after the hole
+    size_t home = hash_vpn(map->slots[i].key - 1) & mask;
+    if (((i - home) & mask) >= ((i - hole) & mask)) {
+      map->slots[hole] = map->slots[i];
+      hole = i;
+    }
+  }
+  map->slots[hole].key = 0;
+  map->count--;
+  return true;
+}
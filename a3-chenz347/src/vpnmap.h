@@ -0,0 +1,37 @@
+#ifndef CSC369_VPNMAP_H
+#define CSC369_VPNMAP_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Hash map from virtual page number to a 64-bit value, for tools and
+// policies that need per-page bookkeeping over a whole trace. Open
+// addressing with linear probing; keys are stored as vpn + 1 so that 0
+// marks an empty slot.
+
+struct vpnmap_entry
+{
+  uint64_t key;
+  uint64_t value;
+};
+
+struct vpnmap
+{
+  struct vpnmap_entry* slots;
+  size_t size; // always a power of 2
+  size_t count;
+};
+
+void
+vpnmap_init(struct vpnmap* map);
+void
+vpnmap_destroy(struct vpnmap* map);
+uint64_t*
+vpnmap_lookup(struct vpnmap* map, uint64_t vpn, bool* inserted);
+uint64_t*
+vpnmap_find(struct vpnmap* map, uint64_t vpn);
+bool
+vpnmap_remove(struct vpnmap* map, uint64_t vpn);
+
+#endif /* CSC369_VPNMAP_H */